@@ -139,6 +139,54 @@ block_write (struct block *block, block_sector_t sector, const void *buffer)
   block->write_cnt++;
 }
 
+/* Reads CNT consecutive sectors starting at SECTOR from BLOCK.
+   The Ith sector is stored into BUFFERS[I], each of which must
+   have room for BLOCK_SECTOR_SIZE bytes.  If BLOCK's driver
+   supports it, the whole run is transferred as one request,
+   which avoids per-sector command overhead. */
+void
+block_read_multiple (struct block *block, block_sector_t sector, size_t cnt,
+                     void *const buffers[])
+{
+  size_t i;
+
+  if (cnt == 0)
+    return;
+  check_sector (block, sector);
+  check_sector (block, sector + cnt - 1);
+  if (block->ops->read_multiple != NULL)
+    block->ops->read_multiple (block->aux, sector, cnt, buffers);
+  else
+    for (i = 0; i < cnt; i++)
+      block->ops->read (block->aux, sector + i, buffers[i]);
+  block->read_cnt += cnt;
+}
+
+/* Writes CNT consecutive sectors starting at SECTOR to BLOCK.
+   The Ith sector is taken from BUFFERS[I], each of which must
+   contain BLOCK_SECTOR_SIZE bytes.  Returns after the block
+   device has acknowledged receiving all of the data.  If
+   BLOCK's driver supports it, the whole run is transferred as
+   one request. */
+void
+block_write_multiple (struct block *block, block_sector_t sector, size_t cnt,
+                      const void *const buffers[])
+{
+  size_t i;
+
+  if (cnt == 0)
+    return;
+  check_sector (block, sector);
+  check_sector (block, sector + cnt - 1);
+  ASSERT (block->type != BLOCK_FOREIGN);
+  if (block->ops->write_multiple != NULL)
+    block->ops->write_multiple (block->aux, sector, cnt, buffers);
+  else
+    for (i = 0; i < cnt; i++)
+      block->ops->write (block->aux, sector + i, buffers[i]);
+  block->write_cnt += cnt;
+}
+
 /* Returns the number of sectors in BLOCK. */
 block_sector_t
 block_size (struct block *block)
@@ -6,11 +6,15 @@
 /* Stores keys from the keyboard and serial port. */
 static struct intq buffer;
 
+/* Woken when a key arrives, for poll(). */
+static struct waitq waitq;
+
 /* Initializes the input buffer. */
 void
 input_init (void)
 {
   intq_init (&buffer);
+  waitq_init (&waitq);
 }
 
 /* Adds a key to the input buffer.
@@ -23,6 +27,7 @@ input_putc (uint8_t key)
 
   intq_putc (&buffer, key);
   serial_notify ();
+  waitq_wake (&waitq);
 }
 
 /* Retrieves a key from the input buffer.
@@ -41,6 +46,42 @@ input_getc (void)
   return key;
 }
 
+/* Retrieves up to SIZE keys from the input buffer into BUF and
+   returns the number retrieved.  If the buffer is empty, waits
+   for a key to be pressed, but otherwise returns just the keys
+   already buffered.  In LINE mode, also stops after a new-line. */
+size_t
+input_read (uint8_t *buf, size_t size, bool line)
+{
+  enum intr_level old_level;
+  size_t cnt;
+
+  old_level = intr_disable ();
+  cnt = intq_read (&buffer, buf, size, line ? '\n' : -1);
+  serial_notify ();
+  intr_set_level (old_level);
+
+  return cnt;
+}
+
+/* Returns true if a key can be retrieved without waiting.  If E
+   is nonnull, also adds it to the queue of entries whose SEMA is
+   upped whenever a key arrives. */
+bool
+input_poll (struct waitq_entry *e, struct semaphore *sema)
+{
+  enum intr_level old_level;
+  bool ready;
+
+  old_level = intr_disable ();
+  if (e != NULL)
+    waitq_add (&waitq, e, sema);
+  ready = !intq_empty (&buffer);
+  intr_set_level (old_level);
+
+  return ready;
+}
+
 /* Returns true if the input buffer is full,
    false otherwise.
    Interrupts must be off. */
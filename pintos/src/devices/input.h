@@ -2,11 +2,17 @@
 #define DEVICES_INPUT_H
 
 #include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
 
+struct semaphore;
+struct waitq_entry;
+
 void input_init (void);
 void input_putc (uint8_t);
 uint8_t input_getc (void);
+size_t input_read (uint8_t *, size_t, bool line);
+bool input_poll (struct waitq_entry *, struct semaphore *);
 bool input_full (void);
 
 #endif /* devices/input.h */
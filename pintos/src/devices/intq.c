@@ -1,5 +1,6 @@
 #include "devices/intq.h"
 #include <debug.h>
+#include <string.h>
 #include "threads/thread.h"
 
 static int next (int pos);
@@ -54,6 +55,52 @@ intq_getc (struct intq *q)
   return byte;
 }
 
+/* Removes up to SIZE bytes from Q into BUF and returns the number
+   removed.  If Q is empty, sleeps until a byte is added, but
+   otherwise takes only the bytes already queued.  If DELIM is
+   nonnegative, stops after removing a byte equal to DELIM.
+   Must not be called from an interrupt handler. */
+size_t
+intq_read (struct intq *q, uint8_t *buf, size_t size, int delim)
+{
+  size_t cnt = 0;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+  if (size == 0)
+    return 0;
+  while (intq_empty (q))
+    {
+      ASSERT (!intr_context ());
+      lock_acquire (&q->lock);
+      wait (q, &q->not_empty);
+      lock_release (&q->lock);
+    }
+
+  while (cnt < size && !intq_empty (q))
+    {
+      /* Take the queued bytes that are contiguous in the buffer. */
+      int run_end = q->head > q->tail ? q->head : INTQ_BUFSIZE;
+      size_t run = run_end - q->tail;
+      const uint8_t *found = NULL;
+
+      if (run > size - cnt)
+        run = size - cnt;
+      if (delim >= 0)
+        {
+          found = memchr (q->buf + q->tail, delim, run);
+          if (found != NULL)
+            run = found - (q->buf + q->tail) + 1;
+        }
+      memcpy (buf + cnt, q->buf + q->tail, run);
+      q->tail = (q->tail + run) % INTQ_BUFSIZE;
+      cnt += run;
+      if (found != NULL)
+        break;
+    }
+  signal (q, &q->not_full);
+  return cnt;
+}
+
 /* Adds BYTE to the end of Q.
    If Q is full, sleeps until a byte is removed.
    When called from an interrupt handler, Q must not be full. */
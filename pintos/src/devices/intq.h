@@ -1,6 +1,7 @@
 #ifndef DEVICES_INTQ_H
 #define DEVICES_INTQ_H
 
+#include <stddef.h>
 #include "threads/interrupt.h"
 #include "threads/synch.h"
 
@@ -38,6 +39,7 @@ void intq_init (struct intq *);
 bool intq_empty (const struct intq *);
 bool intq_full (const struct intq *);
 uint8_t intq_getc (struct intq *);
+size_t intq_read (struct intq *, uint8_t *, size_t, int delim);
 void intq_putc (struct intq *, uint8_t);
 
 #endif /* devices/intq.h */
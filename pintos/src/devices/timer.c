@@ -20,6 +20,9 @@
 /* Number of timer ticks since OS booted. */
 static int64_t ticks;
 
+/* Alarms set and not yet gone off, soonest first. */
+static struct list alarm_list;
+
 /* Number of loops per timer tick.
    Initialized by timer_calibrate(). */
 static unsigned loops_per_tick;
@@ -35,6 +38,7 @@ static void real_time_delay (int64_t num, int32_t denom);
 void
 timer_init (void)
 {
+  list_init (&alarm_list);
   pit_configure_channel (0, 2, TIMER_FREQ);
   intr_register_ext (0x20, timer_interrupt, "8254 Timer");
 }
@@ -89,11 +93,64 @@ timer_elapsed (int64_t then)
 void
 timer_sleep (int64_t ticks)
 {
-  int64_t start = timer_ticks ();
+  struct timer_alarm alarm;
+  struct semaphore sema;
 
   ASSERT (intr_get_level () == INTR_ON);
-  while (timer_elapsed (start) < ticks)
-    thread_yield ();
+  if (ticks <= 0)
+    return;
+
+  /* Block, rather than spin, until the alarm goes off. */
+  sema_init (&sema, 0);
+  timer_alarm_set (&alarm, ticks, &sema);
+  sema_down (&sema);
+}
+
+/* Returns true if alarm A goes off before alarm B. */
+static bool
+alarm_less (const struct list_elem *a_, const struct list_elem *b_,
+            void *aux UNUSED)
+{
+  const struct timer_alarm *a = list_entry (a_, struct timer_alarm, elem);
+  const struct timer_alarm *b = list_entry (b_, struct timer_alarm, elem);
+
+  return a->wakeup < b->wakeup;
+}
+
+/* Sets ALARM to up SEMA once, after approximately TICKS timer
+   ticks.  ALARM must not already be set. */
+void
+timer_alarm_set (struct timer_alarm *alarm, int64_t ticks,
+                 struct semaphore *sema)
+{
+  enum intr_level old_level;
+
+  ASSERT (alarm != NULL);
+  ASSERT (sema != NULL);
+
+  old_level = intr_disable ();
+  alarm->wakeup = timer_ticks () + ticks;
+  alarm->sema = sema;
+  alarm->pending = true;
+  list_insert_ordered (&alarm_list, &alarm->elem, alarm_less, NULL);
+  intr_set_level (old_level);
+}
+
+/* Cancels ALARM, if it has not gone off yet. */
+void
+timer_alarm_cancel (struct timer_alarm *alarm)
+{
+  enum intr_level old_level;
+
+  ASSERT (alarm != NULL);
+
+  old_level = intr_disable ();
+  if (alarm->pending)
+    {
+      list_remove (&alarm->elem);
+      alarm->pending = false;
+    }
+  intr_set_level (old_level);
 }
 
 /* Sleeps for approximately MS milliseconds.  Interrupts must be
@@ -172,6 +229,18 @@ timer_interrupt (struct intr_frame *args UNUSED)
 {
   ticks++;
   thread_tick ();
+
+  /* Set off due alarms. */
+  while (!list_empty (&alarm_list))
+    {
+      struct timer_alarm *alarm = list_entry (list_front (&alarm_list),
+                                              struct timer_alarm, elem);
+      if (alarm->wakeup > ticks)
+        break;
+      list_pop_front (&alarm_list);
+      alarm->pending = false;
+      sema_up (alarm->sema);
+    }
 }
 
 /* Returns true if LOOPS iterations waits for more than one timer
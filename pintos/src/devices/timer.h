@@ -1,9 +1,13 @@
 #ifndef DEVICES_TIMER_H
 #define DEVICES_TIMER_H
 
+#include <list.h>
 #include <round.h>
+#include <stdbool.h>
 #include <stdint.h>
 
+struct semaphore;
+
 /* Number of timer interrupts per second. */
 #define TIMER_FREQ 100
 
@@ -19,6 +23,19 @@ void timer_msleep (int64_t milliseconds);
 void timer_usleep (int64_t microseconds);
 void timer_nsleep (int64_t nanoseconds);
 
+/* An alarm that ups a semaphore once a number of ticks pass. */
+struct timer_alarm
+  {
+    int64_t wakeup;             /* Tick at which to go off. */
+    struct semaphore *sema;     /* Upped when the alarm goes off. */
+    bool pending;               /* Set and not yet gone off? */
+    struct list_elem elem;      /* Element in alarm list. */
+  };
+
+void timer_alarm_set (struct timer_alarm *, int64_t ticks,
+                      struct semaphore *);
+void timer_alarm_cancel (struct timer_alarm *);
+
 /* Busy waits. */
 void timer_mdelay (int64_t milliseconds);
 void timer_udelay (int64_t microseconds);
@@ -0,0 +1,632 @@
+#include "filesys/cache.h"
+#include <debug.h>
+#include <hash.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "devices/timer.h"
+#include "filesys/filesys.h"
+#include "threads/malloc.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+
+/* Buffer cache.  Every sector of the file system device is read
+   and written through one of CACHE_SIZE entries, so that sectors
+   used over and over, such as inodes, directories and the free
+   map, cost disk I/O only the first time.  Victims are chosen
+   with the clock algorithm.
+
+   Writes are write-behind: a modified sector stays dirty in the
+   cache until it is evicted or flushed.  The flusher thread
+   flushes the cache every FLUSH_INTERVAL ticks, writing dirty
+   sectors in ascending order with runs of consecutive ones
+   coalesced into single disk requests, so writers rarely wait
+   for the disk themselves.
+
+   Reads can be asked for ahead of time with cache_read_ahead().
+   The read-ahead thread loads such sectors, a run of consecutive
+   ones at a time, into entries it can get without waiting, so
+   that sequential readers overlap disk latency with their own
+   work.
+
+   A sector written with cache_write_pinned() is pinned: it stays
+   in the cache, and off the disk, until cache_unpin(), so that
+   the journal can log it before it reaches its home location.
+
+   CACHE_LOCK guards the mapping from sectors to entries, kept in
+   a hash table so that finding a sector does not take longer as
+   the cache grows, and
+   each entry's lock guards its data, so threads working on
+   different sectors only contend for the short lookup and do
+   their disk I/O concurrently.  An entry with users is never
+   evicted.  That includes writing back a dirty victim: the entry
+   is retagged for its new sector at once, under CACHE_LOCK, and
+   its old contents are written out later under the entry's own
+   lock.  Until then its old sector is "being written back", and
+   anyone who wants that sector waits rather than read a stale
+   copy from disk.  Entries being written back are indexed by
+   their old sector in a second hash table. */
+
+/* Sector number of an entry that holds no sector. */
+#define NO_SECTOR ((block_sector_t) -1)
+
+/* Ticks between write-backs by the flusher thread. */
+#define FLUSH_INTERVAL TIMER_FREQ
+
+/* Pending read-ahead requests kept at most, and most sectors
+   read ahead in one disk request. */
+#define RA_QUEUE_SIZE 16
+#define RA_BATCH 32
+
+/* A cached sector. */
+struct cache_entry
+  {
+    /* Guarded by cache_lock. */
+    block_sector_t sector;      /* Sector held, or NO_SECTOR. */
+    block_sector_t old_sector;  /* Being written back, or NO_SECTOR. */
+    int users;                  /* Threads using or waiting for it. */
+    bool accessed;              /* Used since the clock hand passed? */
+    bool pinned;                /* Kept from disk?  Set with LOCK too. */
+    struct hash_elem elem;      /* Element in `entries', by SECTOR. */
+    struct hash_elem old_elem;  /* Element in `old_entries'. */
+
+    /* Guarded by LOCK. */
+    struct lock lock;           /* Serializes access to the sector. */
+    bool loaded;                /* DATA holds SECTOR's contents? */
+    bool dirty;                 /* DATA differs from disk? */
+    uint8_t data[BLOCK_SECTOR_SIZE];
+  };
+
+size_t cache_size = CACHE_SIZE;
+
+static struct cache_entry *cache;
+static struct hash entries;             /* Entries holding a sector. */
+static struct hash old_entries;         /* Entries being written back. */
+static struct lock cache_lock;
+static struct condition cache_unused;   /* Some entry lost its users. */
+static struct condition cache_written;  /* Some write-back finished. */
+static size_t clock_hand;               /* Next entry to examine. */
+
+/* Serializes flushes, which share the arrays below. */
+static struct lock flush_lock;
+static struct cache_entry **flush_entries;  /* Dirty entries, sorted. */
+static const void **flush_buffers;          /* Data of a run of them. */
+
+/* A run of sectors to read ahead. */
+struct ra_request
+  {
+    block_sector_t start;       /* First sector. */
+    size_t cnt;                 /* Number of sectors. */
+  };
+
+/* Read-ahead queue, a ring guarded by ra_lock. */
+static struct ra_request ra_queue[RA_QUEUE_SIZE];
+static size_t ra_head, ra_tail;         /* Next to take, next to fill. */
+static struct lock ra_lock;
+static struct condition ra_pending;     /* Queue became nonempty. */
+
+/* Statistics. */
+static unsigned long long hit_cnt;      /* Lookups that found the sector. */
+static unsigned long long miss_cnt;     /* Lookups that had to evict. */
+static unsigned long long ra_cnt;       /* Sectors read ahead. */
+
+static thread_func flusher, read_ahead_thread;
+static hash_hash_func entry_hash, old_entry_hash;
+static hash_less_func entry_less, old_entry_less;
+
+/* Initializes the buffer cache and starts the flusher and
+   read-ahead threads. */
+void
+cache_init (void)
+{
+  size_t i;
+
+  if (cache_size == 0)
+    PANIC ("buffer cache must hold at least one sector");
+  cache = malloc (cache_size * sizeof *cache);
+  flush_entries = malloc (cache_size * sizeof *flush_entries);
+  flush_buffers = malloc (cache_size * sizeof *flush_buffers);
+  if (cache == NULL || flush_entries == NULL || flush_buffers == NULL
+      || !hash_init (&entries, entry_hash, entry_less, NULL)
+      || !hash_init (&old_entries, old_entry_hash, old_entry_less, NULL))
+    PANIC ("could not allocate %zu-sector buffer cache", cache_size);
+  for (i = 0; i < cache_size; i++)
+    {
+      struct cache_entry *e = &cache[i];
+      e->sector = NO_SECTOR;
+      e->old_sector = NO_SECTOR;
+      e->users = 0;
+      e->accessed = false;
+      e->pinned = false;
+      lock_init (&e->lock);
+      e->loaded = false;
+      e->dirty = false;
+    }
+  lock_init (&cache_lock);
+  cond_init (&cache_unused);
+  cond_init (&cache_written);
+  clock_hand = 0;
+  lock_init (&flush_lock);
+  ra_head = ra_tail = 0;
+  lock_init (&ra_lock);
+  cond_init (&ra_pending);
+
+  if (thread_create ("flusher", PRI_DEFAULT, flusher, NULL) == TID_ERROR
+      || thread_create ("readahead", PRI_DEFAULT, read_ahead_thread,
+                        NULL) == TID_ERROR)
+    PANIC ("could not start buffer cache threads");
+}
+
+/* Flusher thread.  Writes dirty sectors back periodically. */
+static void
+flusher (void *aux UNUSED)
+{
+  for (;;)
+    {
+      timer_sleep (FLUSH_INTERVAL);
+      cache_flush ();
+    }
+}
+
+/* Returns a hash value for entry E, by the sector it holds. */
+static unsigned
+entry_hash (const struct hash_elem *e_, void *aux UNUSED)
+{
+  const struct cache_entry *e = hash_entry (e_, struct cache_entry, elem);
+  return hash_int (e->sector);
+}
+
+/* Returns true if entry A holds a lower sector than entry B. */
+static bool
+entry_less (const struct hash_elem *a_, const struct hash_elem *b_,
+            void *aux UNUSED)
+{
+  const struct cache_entry *a = hash_entry (a_, struct cache_entry, elem);
+  const struct cache_entry *b = hash_entry (b_, struct cache_entry, elem);
+  return a->sector < b->sector;
+}
+
+/* Returns a hash value for entry E, by the sector it is writing
+   back. */
+static unsigned
+old_entry_hash (const struct hash_elem *e_, void *aux UNUSED)
+{
+  const struct cache_entry *e = hash_entry (e_, struct cache_entry,
+                                            old_elem);
+  return hash_int (e->old_sector);
+}
+
+/* Returns true if entry A is writing back a lower sector than
+   entry B. */
+static bool
+old_entry_less (const struct hash_elem *a_, const struct hash_elem *b_,
+                void *aux UNUSED)
+{
+  const struct cache_entry *a = hash_entry (a_, struct cache_entry,
+                                            old_elem);
+  const struct cache_entry *b = hash_entry (b_, struct cache_entry,
+                                            old_elem);
+  return a->old_sector < b->old_sector;
+}
+
+/* Returns the entry holding SECTOR, or a null pointer if there
+   is none.  The caller must hold cache_lock. */
+static struct cache_entry *
+lookup (block_sector_t sector)
+{
+  struct cache_entry key;
+  struct hash_elem *e;
+
+  key.sector = sector;
+  e = hash_find (&entries, &key.elem);
+  return e != NULL ? hash_entry (e, struct cache_entry, elem) : NULL;
+}
+
+/* Returns true if SECTOR is being written back from an entry
+   that now holds another.  The caller must hold cache_lock. */
+static bool
+writing_back (block_sector_t sector)
+{
+  struct cache_entry key;
+
+  key.old_sector = sector;
+  return hash_find (&old_entries, &key.old_elem) != NULL;
+}
+
+/* Makes empty entry E hold SECTOR.  The caller must hold
+   cache_lock. */
+static void
+assign (struct cache_entry *e, block_sector_t sector)
+{
+  ASSERT (e->sector == NO_SECTOR);
+
+  e->sector = sector;
+  hash_insert (&entries, &e->elem);
+}
+
+/* Chooses an entry without users that is not pinned with the
+   clock algorithm and returns it, empty.  If it was dirty, its
+   old sector is left for finish_eviction() to write back, so the
+   caller must give it a user before releasing cache_lock.  If
+   there is no such entry, waits for one if MAY_WAIT is true, or
+   returns a null pointer otherwise.  The caller must hold
+   cache_lock. */
+static struct cache_entry *
+evict (bool may_wait)
+{
+  for (;;)
+    {
+      size_t i;
+
+      /* Two sweeps clear every accessed bit on the way. */
+      for (i = 0; i < 2 * cache_size; i++)
+        {
+          struct cache_entry *e = &cache[clock_hand];
+          clock_hand = (clock_hand + 1) % cache_size;
+
+          if (e->users > 0 || e->pinned)
+            continue;
+          if (e->sector != NO_SECTOR && e->accessed)
+            {
+              e->accessed = false;
+              continue;
+            }
+
+          /* Nobody else can hold E's lock without being a user. */
+          if (e->sector != NO_SECTOR)
+            {
+              hash_delete (&entries, &e->elem);
+              if (e->dirty)
+                {
+                  e->old_sector = e->sector;
+                  hash_insert (&old_entries, &e->old_elem);
+                }
+            }
+          e->sector = NO_SECTOR;
+          e->loaded = false;
+          e->dirty = false;
+          return e;
+        }
+      if (!may_wait)
+        return NULL;
+      cond_wait (&cache_unused, &cache_lock);
+    }
+}
+
+/* Writes back the sector that entry E held before evict() chose
+   it, if it was dirty.  E's lock must be held, which keeps
+   OLD_SECTOR from changing otherwise. */
+static void
+finish_eviction (struct cache_entry *e)
+{
+  if (e->old_sector == NO_SECTOR)
+    return;
+  block_write (fs_device, e->old_sector, e->data);
+
+  lock_acquire (&cache_lock);
+  hash_delete (&old_entries, &e->old_elem);
+  e->old_sector = NO_SECTOR;
+  cond_broadcast (&cache_written, &cache_lock);
+  lock_release (&cache_lock);
+}
+
+/* Returns the entry for SECTOR, holding its lock, evicting
+   another sector if necessary.  Reads SECTOR in from disk unless
+   it is cached already or OVERWRITE is true, in which case the
+   caller must replace all of its data. */
+static struct cache_entry *
+acquire (block_sector_t sector, bool overwrite)
+{
+  struct cache_entry *e;
+
+  ASSERT (sector != NO_SECTOR);
+
+  lock_acquire (&cache_lock);
+  while ((e = lookup (sector)) == NULL && writing_back (sector))
+    cond_wait (&cache_written, &cache_lock);
+  if (e != NULL)
+    hit_cnt++;
+  else
+    {
+      miss_cnt++;
+      e = evict (true);
+      assign (e, sector);
+    }
+  e->users++;
+  e->accessed = true;
+  lock_release (&cache_lock);
+
+  lock_acquire (&e->lock);
+  finish_eviction (e);
+  if (!e->loaded)
+    {
+      if (!overwrite)
+        block_read (fs_device, sector, e->data);
+      e->loaded = true;
+    }
+  return e;
+}
+
+/* Releases entry E, obtained from acquire(), marking it dirty
+   if DIRTY is true. */
+static void
+release (struct cache_entry *e, bool dirty)
+{
+  if (dirty)
+    e->dirty = true;
+  lock_release (&e->lock);
+
+  lock_acquire (&cache_lock);
+  if (--e->users == 0)
+    cond_signal (&cache_unused, &cache_lock);
+  lock_release (&cache_lock);
+}
+
+/* Reads SIZE bytes starting at offset OFS within SECTOR into
+   BUFFER. */
+void
+cache_read (block_sector_t sector, void *buffer, size_t ofs, size_t size)
+{
+  struct cache_entry *e;
+
+  ASSERT (ofs + size <= BLOCK_SECTOR_SIZE);
+
+  e = acquire (sector, false);
+  memcpy (buffer, e->data + ofs, size);
+  release (e, false);
+}
+
+/* Writes SIZE bytes from BUFFER into SECTOR, starting at offset
+   OFS within it.  The sector reaches the disk when it is evicted
+   or the cache is flushed. */
+void
+cache_write (block_sector_t sector, const void *buffer, size_t ofs,
+             size_t size)
+{
+  struct cache_entry *e;
+
+  ASSERT (ofs + size <= BLOCK_SECTOR_SIZE);
+
+  e = acquire (sector, ofs == 0 && size == BLOCK_SECTOR_SIZE);
+  memcpy (e->data + ofs, buffer, size);
+  release (e, true);
+}
+
+/* Writes SIZE bytes from BUFFER into SECTOR, starting at offset
+   OFS within it, and pins SECTOR, so that it does not reach the
+   disk until cache_unpin() is called for it. */
+void
+cache_write_pinned (block_sector_t sector, const void *buffer, size_t ofs,
+                    size_t size)
+{
+  struct cache_entry *e;
+
+  ASSERT (ofs + size <= BLOCK_SECTOR_SIZE);
+
+  e = acquire (sector, ofs == 0 && size == BLOCK_SECTOR_SIZE);
+  lock_acquire (&cache_lock);
+  e->pinned = true;
+  lock_release (&cache_lock);
+  memcpy (e->data + ofs, buffer, size);
+  release (e, true);
+}
+
+/* Unpins SECTOR, which must have been pinned by
+   cache_write_pinned(), letting it be written back again. */
+void
+cache_unpin (block_sector_t sector)
+{
+  struct cache_entry *e;
+
+  lock_acquire (&cache_lock);
+  e = lookup (sector);
+  ASSERT (e != NULL && e->pinned);
+  e->pinned = false;
+  cond_signal (&cache_unused, &cache_lock);
+  lock_release (&cache_lock);
+}
+
+/* Asks for the CNT sectors starting at START to be read into
+   the cache in the background.  Returns at once; the request is
+   dropped if too many are pending already. */
+void
+cache_read_ahead (block_sector_t start, size_t cnt)
+{
+  lock_acquire (&ra_lock);
+  if ((ra_tail + 1) % RA_QUEUE_SIZE != ra_head)
+    {
+      ra_queue[ra_tail].start = start;
+      ra_queue[ra_tail].cnt = cnt;
+      ra_tail = (ra_tail + 1) % RA_QUEUE_SIZE;
+      cond_signal (&ra_pending, &ra_lock);
+    }
+  lock_release (&ra_lock);
+}
+
+/* Reads the CNT sectors starting at START, at most RA_BATCH,
+   into the cache, except those cached already.  Stops short
+   rather than wait for an entry. */
+static void
+read_ahead_run (block_sector_t start, size_t cnt)
+{
+  struct cache_entry *entries[RA_BATCH];
+  void *buffers[RA_BATCH];
+  size_t i, j;
+
+  ASSERT (cnt <= RA_BATCH);
+
+  /* Claim an entry for each sector not in the cache. */
+  lock_acquire (&cache_lock);
+  for (i = 0; i < cnt; i++)
+    if (lookup (start + i) != NULL || writing_back (start + i))
+      entries[i] = NULL;
+    else
+      {
+        struct cache_entry *e = evict (false);
+        if (e == NULL)
+          break;
+        assign (e, start + i);
+        e->users++;
+        e->accessed = true;
+        entries[i] = e;
+      }
+  cnt = i;
+  lock_release (&cache_lock);
+
+  /* Lock them in ascending order, as cache_flush() does.  A reader
+     may have loaded some in the meantime. */
+  for (i = 0; i < cnt; i++)
+    if (entries[i] != NULL)
+      {
+        lock_acquire (&entries[i]->lock);
+        finish_eviction (entries[i]);
+        if (entries[i]->loaded)
+          {
+            release (entries[i], false);
+            entries[i] = NULL;
+          }
+      }
+
+  /* Read each run of consecutive claimed sectors at once. */
+  for (i = 0; i < cnt; i = j)
+    {
+      size_t k;
+
+      if (entries[i] == NULL)
+        {
+          j = i + 1;
+          continue;
+        }
+      for (j = i; j < cnt && entries[j] != NULL; j++)
+        buffers[j - i] = entries[j]->data;
+      block_read_multiple (fs_device, start + i, j - i, buffers);
+      ra_cnt += j - i;
+      for (k = i; k < j; k++)
+        {
+          entries[k]->loaded = true;
+          release (entries[k], false);
+        }
+    }
+}
+
+/* Read-ahead thread.  Serves cache_read_ahead() requests. */
+static void
+read_ahead_thread (void *aux UNUSED)
+{
+  for (;;)
+    {
+      struct ra_request r;
+
+      lock_acquire (&ra_lock);
+      while (ra_head == ra_tail)
+        cond_wait (&ra_pending, &ra_lock);
+      r = ra_queue[ra_head];
+      ra_head = (ra_head + 1) % RA_QUEUE_SIZE;
+      lock_release (&ra_lock);
+
+      while (r.cnt > 0)
+        {
+          size_t cnt = r.cnt < RA_BATCH ? r.cnt : RA_BATCH;
+          read_ahead_run (r.start, cnt);
+          r.start += cnt;
+          r.cnt -= cnt;
+        }
+    }
+}
+
+/* Orders cache entries by ascending sector number. */
+static int
+compare_sectors (const void *a_, const void *b_)
+{
+  const struct cache_entry *a = *(struct cache_entry *const *) a_;
+  const struct cache_entry *b = *(struct cache_entry *const *) b_;
+
+  return a->sector < b->sector ? -1 : a->sector > b->sector;
+}
+
+/* Writes every dirty sector in the cache that is not pinned back
+   to disk, in ascending order, each run of consecutive sectors in
+   one disk request, and waits for write-backs of evicted sectors
+   under way. */
+void
+cache_flush (void)
+{
+  size_t dirty_cnt, evicted_cnt;
+  size_t i, j;
+
+  lock_acquire (&flush_lock);
+
+  /* Collect the dirty entries, keeping them from eviction.  An
+     entry's DIRTY is only read here without its lock: one that is
+     dirtied later is caught by the next flush. */
+  dirty_cnt = evicted_cnt = 0;
+  lock_acquire (&cache_lock);
+  for (i = 0; i < cache_size; i++)
+    if (cache[i].old_sector != NO_SECTOR)
+      {
+        /* Put these at the end, out of the way of the runs. */
+        cache[i].users++;
+        flush_entries[cache_size - ++evicted_cnt] = &cache[i];
+      }
+    else if (cache[i].sector != NO_SECTOR && cache[i].dirty
+             && !cache[i].pinned)
+      {
+        cache[i].users++;
+        flush_entries[dirty_cnt++] = &cache[i];
+      }
+  lock_release (&cache_lock);
+  qsort (flush_entries, dirty_cnt, sizeof *flush_entries, compare_sectors);
+
+  /* Write them back a run at a time.  Entry locks are taken in
+     ascending order and nobody else holds more than one, so this
+     cannot deadlock.  An entry pinned since it was collected ends
+     its run unwritten. */
+  for (i = 0; i < dirty_cnt; i = j)
+    {
+      block_sector_t start = flush_entries[i]->sector;
+      size_t cnt = 0;
+      size_t k;
+
+      for (j = i; j < dirty_cnt
+                  && flush_entries[j]->sector == start + cnt; j++)
+        {
+          struct cache_entry *e = flush_entries[j];
+          lock_acquire (&e->lock);
+          if (e->pinned)
+            {
+              release (e, false);
+              j++;
+              break;
+            }
+          flush_buffers[cnt++] = e->data;
+        }
+      if (cnt > 0)
+        block_write_multiple (fs_device, start, cnt, flush_buffers);
+      for (k = i; k < i + cnt; k++)
+        {
+          flush_entries[k]->dirty = false;
+          release (flush_entries[k], false);
+        }
+    }
+
+  /* Whoever claimed an evicted entry may not have written its old
+     sector back yet.  Do it for them if so. */
+  for (i = cache_size - evicted_cnt; i < cache_size; i++)
+    {
+      lock_acquire (&flush_entries[i]->lock);
+      finish_eviction (flush_entries[i]);
+      release (flush_entries[i], false);
+    }
+
+  lock_release (&flush_lock);
+}
+
+/* Prints buffer cache statistics. */
+void
+cache_print_stats (void)
+{
+  printf ("Buffer cache: %llu hits, %llu misses, %llu read ahead\n",
+          hit_cnt, miss_cnt, ra_cnt);
+}
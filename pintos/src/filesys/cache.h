@@ -0,0 +1,25 @@
+#ifndef FILESYS_CACHE_H
+#define FILESYS_CACHE_H
+
+#include <stddef.h>
+#include "devices/block.h"
+
+/* Default number of sectors in the buffer cache. */
+#define CACHE_SIZE 64
+
+/* Number of sectors in the buffer cache, settable on the kernel
+   command line before the file system is initialized. */
+extern size_t cache_size;
+
+void cache_init (void);
+void cache_read (block_sector_t, void *buffer, size_t ofs, size_t size);
+void cache_write (block_sector_t, const void *buffer, size_t ofs,
+                  size_t size);
+void cache_write_pinned (block_sector_t, const void *buffer, size_t ofs,
+                         size_t size);
+void cache_unpin (block_sector_t);
+void cache_read_ahead (block_sector_t, size_t cnt);
+void cache_flush (void);
+void cache_print_stats (void);
+
+#endif /* filesys/cache.h */
@@ -1,10 +1,14 @@
 #include "filesys/directory.h"
 #include <stdio.h>
 #include <string.h>
+#include <hash.h>
 #include <list.h>
 #include "filesys/filesys.h"
+#include "filesys/free-map.h"
 #include "filesys/inode.h"
+#include "filesys/journal.h"
 #include "threads/malloc.h"
+#include "threads/synch.h"
 
 /* A directory. */
 struct dir
@@ -21,12 +25,261 @@ struct dir_entry
     bool in_use;                        /* In use or free? */
   };
 
+/* Directory formats.
+
+   A small directory is a plain array of entries, searched
+   linearly.  Once one holds DIR_LINEAR_MAX entries and needs
+   another, it is converted to a hashed directory, which indexes
+   its entries by name with extendible hashing:
+
+     - Sector 0 of the file is a struct dir_header.  Its magic
+       number, which no real entry's inode sector ever reaches,
+       tells the formats apart.
+
+     - The following sectors hold the bucket table: 1 << DEPTH
+       bucket numbers, indexed by the low DEPTH bits of a name's
+       hash.  The largest table is allocated when the directory
+       is converted, so that growing it allocates nothing.
+
+     - Buckets follow, one struct dir_bucket per sector.  A full
+       bucket splits in two by one more hash bit, doubling the
+       table first if it already uses all DEPTH bits.
+
+   A name is thus found with three sector reads at most, however
+   many entries the directory holds.
+
+   DIR_LINEAR_MAX leaves room for one more entry in a bucket, so
+   that converting never splits one, and adding an entry splits a
+   bucket once at most.  Along with the small table, that bounds
+   the sectors dir_add() may write, for dir_add_credits(). */
+#define BUCKET_ENTRIES 25
+#define DIR_LINEAR_MAX (BUCKET_ENTRIES - 1)
+#define DIR_HASH_MAGIC 0x52494448
+#define DIR_MAX_DEPTH 8
+#define DIR_TABLE_OFS BLOCK_SECTOR_SIZE
+#define DIR_TABLE_SIZE ((1 << DIR_MAX_DEPTH) * (off_t) sizeof (uint32_t))
+#define DIR_TABLE_SECTORS (DIR_TABLE_SIZE / BLOCK_SECTOR_SIZE)
+#define DIR_BUCKET_OFS (DIR_TABLE_OFS + DIR_TABLE_SIZE)
+
+/* Header of a hashed directory. */
+struct dir_header
+  {
+    uint32_t magic;                     /* DIR_HASH_MAGIC. */
+    uint32_t depth;                     /* Hash bits used by the table. */
+    uint32_t bucket_cnt;                /* Number of buckets. */
+  };
+
+/* A bucket of a hashed directory.
+   Must fit in BLOCK_SECTOR_SIZE bytes. */
+struct dir_bucket
+  {
+    uint32_t depth;                     /* Hash bits shared by entries. */
+    struct dir_entry entries[BUCKET_ENTRIES];
+  };
+
+/* Byte offset of bucket B, and of entry I within it. */
+static inline off_t
+bucket_ofs (uint32_t b)
+{
+  return DIR_BUCKET_OFS + b * BLOCK_SECTOR_SIZE;
+}
+
+static inline off_t
+entry_ofs (uint32_t b, size_t i)
+{
+  return (bucket_ofs (b) + offsetof (struct dir_bucket, entries)
+          + i * sizeof (struct dir_entry));
+}
+
+/* Name lookup cache.
+
+   Maps a name within a directory, identified by its inode's
+   sector, to the sector of the named file's inode, or to
+   NO_SECTOR if the directory has no such file, so that repeated
+   lookups of the same path components need not read the
+   directories at all.  dir_add() and dir_remove() drop the entry
+   for the name they change, and dir_create() every entry of the
+   directory previously in its sector.  The least recently used
+   entry makes way for a new one once there are
+   DENTRY_CACHE_SIZE. */
+#define DENTRY_CACHE_SIZE 256
+#define NO_SECTOR ((block_sector_t) -1)
+
+/* A cached name lookup. */
+struct dentry
+  {
+    struct hash_elem hash_elem;         /* Element in dentries. */
+    struct list_elem lru_elem;          /* Element in dentry_lru. */
+    block_sector_t parent;              /* Directory's inode sector. */
+    char name[NAME_MAX + 1];            /* Null terminated file name. */
+    block_sector_t sector;              /* File's inode or NO_SECTOR. */
+  };
+
+static struct hash dentries;            /* Cached lookups. */
+static struct list dentry_lru;          /* Most recently used first. */
+static size_t dentry_cnt;               /* Number of cached lookups. */
+
+/* Incremented whenever an entry is dropped, so that a lookup
+   that raced with a change to its directory does not cache a
+   stale result. */
+static unsigned dentry_gen;
+
+/* Guards all of the above. */
+static struct lock dentry_lock;
+
+static hash_hash_func dentry_hash;
+static hash_less_func dentry_less;
+
+/* Initializes the directory module. */
+void
+dir_init (void)
+{
+  if (!hash_init (&dentries, dentry_hash, dentry_less, NULL))
+    PANIC ("name lookup cache creation failed");
+  list_init (&dentry_lru);
+  lock_init (&dentry_lock);
+}
+
+/* Returns a hash value for dentry D. */
+static unsigned
+dentry_hash (const struct hash_elem *d_, void *aux UNUSED)
+{
+  const struct dentry *d = hash_entry (d_, struct dentry, hash_elem);
+  return hash_int (d->parent) ^ hash_string (d->name);
+}
+
+/* Returns true if dentry A precedes dentry B. */
+static bool
+dentry_less (const struct hash_elem *a_, const struct hash_elem *b_,
+             void *aux UNUSED)
+{
+  const struct dentry *a = hash_entry (a_, struct dentry, hash_elem);
+  const struct dentry *b = hash_entry (b_, struct dentry, hash_elem);
+  if (a->parent != b->parent)
+    return a->parent < b->parent;
+  return strcmp (a->name, b->name) < 0;
+}
+
+/* Returns the cached lookup of NAME in the directory in sector
+   PARENT, or a null pointer if there is none.
+   dentry_lock must be held. */
+static struct dentry *
+dentry_find (block_sector_t parent, const char *name)
+{
+  struct dentry key;
+  struct hash_elem *e;
+
+  key.parent = parent;
+  strlcpy (key.name, name, sizeof key.name);
+  e = hash_find (&dentries, &key.hash_elem);
+  return e != NULL ? hash_entry (e, struct dentry, hash_elem) : NULL;
+}
+
+/* Drops dentry D from the cache and frees it.
+   dentry_lock must be held. */
+static void
+dentry_drop (struct dentry *d)
+{
+  hash_delete (&dentries, &d->hash_elem);
+  list_remove (&d->lru_elem);
+  dentry_cnt--;
+  free (d);
+}
+
+/* Looks up NAME in the directory in sector PARENT in the cache.
+   If it is there, returns true and stores the file's inode
+   sector, or NO_SECTOR if there is no such file, into *SECTORP.
+   Otherwise, returns false and stores the current generation
+   into *GENP, for dentry_insert(). */
+static bool
+dentry_lookup (block_sector_t parent, const char *name,
+               block_sector_t *sectorp, unsigned *genp)
+{
+  struct dentry *d;
+
+  lock_acquire (&dentry_lock);
+  d = dentry_find (parent, name);
+  if (d != NULL)
+    {
+      list_remove (&d->lru_elem);
+      list_push_front (&dentry_lru, &d->lru_elem);
+      *sectorp = d->sector;
+    }
+  else
+    *genp = dentry_gen;
+  lock_release (&dentry_lock);
+  return d != NULL;
+}
+
+/* Caches SECTOR as the result of looking up NAME in the
+   directory in sector PARENT, unless an entry has been dropped
+   since dentry_lookup() returned generation GEN. */
+static void
+dentry_insert (block_sector_t parent, const char *name,
+               block_sector_t sector, unsigned gen)
+{
+  struct dentry *d = malloc (sizeof *d);
+  if (d == NULL)
+    return;
+  d->parent = parent;
+  strlcpy (d->name, name, sizeof d->name);
+  d->sector = sector;
+
+  lock_acquire (&dentry_lock);
+  if (gen == dentry_gen && hash_insert (&dentries, &d->hash_elem) == NULL)
+    {
+      list_push_front (&dentry_lru, &d->lru_elem);
+      if (++dentry_cnt > DENTRY_CACHE_SIZE)
+        dentry_drop (list_entry (list_back (&dentry_lru),
+                                 struct dentry, lru_elem));
+      d = NULL;
+    }
+  lock_release (&dentry_lock);
+  free (d);
+}
+
+/* Drops the cached lookup of NAME in the directory in sector
+   PARENT, or of every name in it if NAME is a null pointer. */
+static void
+dentry_invalidate (block_sector_t parent, const char *name)
+{
+  lock_acquire (&dentry_lock);
+  dentry_gen++;
+  if (name != NULL)
+    {
+      struct dentry *d = dentry_find (parent, name);
+      if (d != NULL)
+        dentry_drop (d);
+    }
+  else
+    {
+      struct list_elem *e = list_begin (&dentry_lru);
+      while (e != list_end (&dentry_lru))
+        {
+          struct dentry *d = list_entry (e, struct dentry, lru_elem);
+          e = list_next (e);
+          if (d->parent == parent)
+            dentry_drop (d);
+        }
+    }
+  lock_release (&dentry_lock);
+}
+
 /* Creates a directory with space for ENTRY_CNT entries in the
    given SECTOR.  Returns true if successful, false on failure. */
 bool
 dir_create (block_sector_t sector, size_t entry_cnt)
 {
-  return inode_create (sector, entry_cnt * sizeof (struct dir_entry));
+  dentry_invalidate (sector, NULL);
+  return inode_create (sector, entry_cnt * sizeof (struct dir_entry), true);
+}
+
+/* Returns the most sectors that dir_create() may add to a journal
+   transaction for a directory with ENTRY_CNT entries. */
+size_t
+dir_create_credits (size_t entry_cnt)
+{
+  return inode_create_credits (entry_cnt * sizeof (struct dir_entry), true);
 }
 
 /* Opens and returns the directory for the given INODE, of which
@@ -83,6 +336,50 @@ dir_get_inode (struct dir *dir)
   return dir->inode;
 }
 
+/* Reads DIR's header into *H and returns true if DIR is hashed,
+   or returns false if it is linear. */
+static bool
+read_header (const struct dir *dir, struct dir_header *h)
+{
+  return (inode_read_at (dir->inode, h, sizeof *h, 0) == sizeof *h
+          && h->magic == DIR_HASH_MAGIC);
+}
+
+/* Returns the number of the bucket in slot IDX of DIR's table. */
+static uint32_t
+get_slot (const struct dir *dir, uint32_t idx)
+{
+  uint32_t b = 0;
+  inode_read_at (dir->inode, &b, sizeof b, DIR_TABLE_OFS + idx * sizeof b);
+  return b;
+}
+
+/* Points slot IDX of DIR's table to bucket B. */
+static bool
+set_slot (struct dir *dir, uint32_t idx, uint32_t b)
+{
+  return inode_write_at (dir->inode, &b, sizeof b,
+                         DIR_TABLE_OFS + idx * sizeof b) == sizeof b;
+}
+
+/* Returns the number of the bucket of hashed DIR, with header H,
+   for NAME, and reads it into BUCKET.  Stores the table slot that
+   led there into *IDXP if IDXP is non-null. */
+static uint32_t
+find_bucket (const struct dir *dir, const struct dir_header *h,
+             const char *name, struct dir_bucket *bucket, uint32_t *idxp)
+{
+  uint32_t idx = hash_string (name) & ((1u << h->depth) - 1);
+  uint32_t b = get_slot (dir, idx);
+
+  if (idxp != NULL)
+    *idxp = idx;
+  if (inode_read_at (dir->inode, bucket, sizeof *bucket, bucket_ofs (b))
+      != sizeof *bucket)
+    memset (bucket, 0, sizeof *bucket);
+  return b;
+}
+
 /* Searches DIR for a file with the given NAME.
    If successful, returns true, sets *EP to the directory entry
    if EP is non-null, and sets *OFSP to the byte offset of the
@@ -92,12 +389,38 @@ static bool
 lookup (const struct dir *dir, const char *name,
         struct dir_entry *ep, off_t *ofsp)
 {
+  struct dir_header h;
   struct dir_entry e;
   size_t ofs;
 
   ASSERT (dir != NULL);
   ASSERT (name != NULL);
 
+  if (read_header (dir, &h))
+    {
+      struct dir_bucket *bucket = malloc (sizeof *bucket);
+      bool found = false;
+      uint32_t b;
+      size_t i;
+
+      if (bucket == NULL)
+        return false;
+      b = find_bucket (dir, &h, name, bucket, NULL);
+      for (i = 0; i < BUCKET_ENTRIES; i++)
+        if (bucket->entries[i].in_use
+            && !strcmp (name, bucket->entries[i].name))
+          {
+            if (ep != NULL)
+              *ep = bucket->entries[i];
+            if (ofsp != NULL)
+              *ofsp = entry_ofs (b, i);
+            found = true;
+            break;
+          }
+      free (bucket);
+      return found;
+    }
+
   for (ofs = 0; inode_read_at (dir->inode, &e, sizeof e, ofs) == sizeof e;
        ofs += sizeof e)
     if (e.in_use && !strcmp (name, e.name))
@@ -119,43 +442,185 @@ bool
 dir_lookup (const struct dir *dir, const char *name,
             struct inode **inode)
 {
+  block_sector_t parent = inode_get_inumber (dir->inode);
+  block_sector_t sector;
   struct dir_entry e;
+  unsigned gen;
 
   ASSERT (dir != NULL);
   ASSERT (name != NULL);
 
-  if (lookup (dir, name, &e, NULL))
-    *inode = inode_open (e.inode_sector);
-  else
-    *inode = NULL;
+  if (!dentry_lookup (parent, name, &sector, &gen))
+    {
+      sector = lookup (dir, name, &e, NULL) ? e.inode_sector : NO_SECTOR;
+      dentry_insert (parent, name, sector, gen);
+    }
 
+  *inode = sector != NO_SECTOR ? inode_open (sector) : NULL;
   return *inode != NULL;
 }
 
-/* Adds a file named NAME to DIR, which must not already contain a
-   file by that name.  The file's inode is in sector
-   INODE_SECTOR.
-   Returns true if successful, false on failure.
-   Fails if NAME is invalid (i.e. too long) or a disk or memory
-   error occurs. */
-bool
-dir_add (struct dir *dir, const char *name, block_sector_t inode_sector)
+/* Splits bucket B of hashed DIR, with header *H, which is
+   already in BUCKET and was reached through table slot IDX,
+   moving the entries with the next hash bit set to a new bucket.
+   Doubles the table first if B uses all of its bits.  Returns
+   false if the table is as large as it gets or a disk error
+   occurs. */
+static bool
+split_bucket (struct dir *dir, struct dir_header *h, uint32_t b,
+              struct dir_bucket *bucket, uint32_t idx)
 {
-  struct dir_entry e;
-  off_t ofs;
+  struct dir_bucket *upper;
+  uint32_t nb, bit, i;
   bool success = false;
 
-  ASSERT (dir != NULL);
-  ASSERT (name != NULL);
+  if (bucket->depth == h->depth)
+    {
+      uint32_t size = 1u << h->depth;
+
+      if (h->depth == DIR_MAX_DEPTH)
+        return false;
+      for (i = 0; i < size; i++)
+        if (!set_slot (dir, i + size, get_slot (dir, i)))
+          return false;
+      h->depth++;
+    }
 
-  /* Check NAME for validity. */
-  if (*name == '\0' || strlen (name) > NAME_MAX)
+  upper = calloc (1, sizeof *upper);
+  if (upper == NULL)
     return false;
 
-  /* Check that NAME is not in use. */
-  if (lookup (dir, name, NULL, NULL))
+  /* Move the entries with the new bit set. */
+  bit = 1u << bucket->depth;
+  nb = h->bucket_cnt++;
+  bucket->depth++;
+  upper->depth = bucket->depth;
+  for (i = 0; i < BUCKET_ENTRIES; i++)
+    if (bucket->entries[i].in_use
+        && (hash_string (bucket->entries[i].name) & bit))
+      {
+        upper->entries[i] = bucket->entries[i];
+        bucket->entries[i].in_use = false;
+      }
+  if (inode_write_at (dir->inode, upper, sizeof *upper, bucket_ofs (nb))
+      != sizeof *upper
+      || inode_write_at (dir->inode, bucket, sizeof *bucket, bucket_ofs (b))
+         != sizeof *bucket)
+    goto done;
+
+  /* The slots that held B are those that agree with it in its
+     old bits; point the ones with the new bit set to NB. */
+  for (i = (idx & (bit - 1)) | bit; i < (1u << h->depth); i += bit << 1)
+    if (!set_slot (dir, i, nb))
+      goto done;
+  success = inode_write_at (dir->inode, h, sizeof *h, 0) == sizeof *h;
+
+ done:
+  free (upper);
+  return success;
+}
+
+/* Adds an entry for NAME, with its inode in INODE_SECTOR, to
+   hashed DIR with header *H, splitting NAME's bucket if it has no
+   room.  Fails if it has none even then, which happens only if
+   all of its entries agree in one more bit of their hashes. */
+static bool
+hashed_add (struct dir *dir, struct dir_header *h, const char *name,
+            block_sector_t inode_sector)
+{
+  struct dir_bucket *bucket = malloc (sizeof *bucket);
+  bool split = false;
+  bool success = false;
+
+  if (bucket == NULL)
+    return false;
+  for (;;)
+    {
+      uint32_t idx;
+      uint32_t b = find_bucket (dir, h, name, bucket, &idx);
+      size_t i;
+
+      for (i = 0; i < BUCKET_ENTRIES; i++)
+        if (!bucket->entries[i].in_use)
+          {
+            struct dir_entry *e = &bucket->entries[i];
+            e->in_use = true;
+            strlcpy (e->name, name, sizeof e->name);
+            e->inode_sector = inode_sector;
+            success = (inode_write_at (dir->inode, e, sizeof *e,
+                                       entry_ofs (b, i)) == sizeof *e);
+            goto done;
+          }
+      if (split || !split_bucket (dir, h, b, bucket, idx))
+        goto done;
+      split = true;
+    }
+
+ done:
+  free (bucket);
+  return success;
+}
+
+/* Converts linear DIR, whose ENTRY_CNT entries are all in use,
+   to a hashed directory and stores its new header into *H.
+   ENTRY_CNT must leave room for another entry in a bucket. */
+static bool
+convert_to_hashed (struct dir *dir, struct dir_header *h, size_t entry_cnt)
+{
+  struct dir_entry *entries;
+  struct dir_bucket *bucket;
+  uint32_t *table;
+  bool success = false;
+  size_t i;
+
+  ASSERT (entry_cnt < BUCKET_ENTRIES);
+
+  entries = malloc (entry_cnt * sizeof *entries);
+  bucket = calloc (1, sizeof *bucket);
+  table = calloc (1, DIR_TABLE_SIZE);
+  if (entries == NULL || bucket == NULL || table == NULL
+      || (inode_read_at (dir->inode, entries, entry_cnt * sizeof *entries, 0)
+          != (off_t) (entry_cnt * sizeof *entries)))
+    goto done;
+
+  /* Start with a single, empty bucket, to which every slot of the
+     whole table points. */
+  h->magic = DIR_HASH_MAGIC;
+  h->depth = 0;
+  h->bucket_cnt = 1;
+  if (inode_write_at (dir->inode, bucket, sizeof *bucket, bucket_ofs (0))
+      != sizeof *bucket
+      || (inode_write_at (dir->inode, table, DIR_TABLE_SIZE, DIR_TABLE_OFS)
+          != DIR_TABLE_SIZE)
+      || inode_write_at (dir->inode, h, sizeof *h, 0) != sizeof *h)
     goto done;
 
+  for (i = 0; i < entry_cnt; i++)
+    if (!hashed_add (dir, h, entries[i].name, entries[i].inode_sector))
+      goto done;
+  success = true;
+
+ done:
+  free (table);
+  free (bucket);
+  free (entries);
+  return success;
+}
+
+/* Adds an entry for NAME, with its inode in INODE_SECTOR, to
+   DIR, which does not contain one yet, converting DIR to a
+   hashed directory if it is time to. */
+static bool
+add_entry (struct dir *dir, const char *name, block_sector_t inode_sector)
+{
+  struct dir_header h;
+  struct dir_entry e;
+  bool full = true;
+  off_t ofs;
+
+  if (read_header (dir, &h))
+    return hashed_add (dir, &h, name, inode_sector);
+
   /* Set OFS to offset of free slot.
      If there are no free slots, then it will be set to the
      current end-of-file.
@@ -166,18 +631,86 @@ dir_add (struct dir *dir, const char *name, block_sector_t inode_sector)
   for (ofs = 0; inode_read_at (dir->inode, &e, sizeof e, ofs) == sizeof e;
        ofs += sizeof e)
     if (!e.in_use)
-      break;
+      {
+        full = false;
+        break;
+      }
+
+  /* A full directory that has grown large enough is worth
+     indexing instead.  One with a free slot is not converted,
+     since the entries past the slot would be left behind, nor is
+     one created with more entries than a bucket holds. */
+  if (full && ofs / sizeof e == DIR_LINEAR_MAX)
+    return (convert_to_hashed (dir, &h, ofs / sizeof e)
+            && hashed_add (dir, &h, name, inode_sector));
 
   /* Write slot. */
   e.in_use = true;
   strlcpy (e.name, name, sizeof e.name);
   e.inode_sector = inode_sector;
-  success = inode_write_at (dir->inode, &e, sizeof e, ofs) == sizeof e;
+  return inode_write_at (dir->inode, &e, sizeof e, ofs) == sizeof e;
+}
+
+/* Adds a file named NAME to DIR, which must not already contain a
+   file by that name.  The file's inode is in sector
+   INODE_SECTOR.
+   Returns true if successful, false on failure.
+   Fails if NAME is invalid (i.e. too long) or a disk or memory
+   error occurs. */
+bool
+dir_add (struct dir *dir, const char *name, block_sector_t inode_sector)
+{
+  bool success = false;
+
+  ASSERT (dir != NULL);
+  ASSERT (name != NULL);
+
+  /* Check NAME for validity. */
+  if (*name == '\0' || strlen (name) > NAME_MAX)
+    return false;
+
+  /* Check that NAME is not in use. */
+  journal_begin (dir_add_credits (dir));
+  if (lookup (dir, name, NULL, NULL))
+    goto done;
+
+  success = add_entry (dir, name, inode_sector);
+  dentry_invalidate (inode_get_inumber (dir->inode), name);
 
  done:
+  journal_end ();
   return success;
 }
 
+/* Returns the most sectors that dir_add() may add to a journal
+   transaction for DIR.  Adding to a hashed directory writes the
+   header, the table, NAME's bucket and a new one split off from
+   it, which must be allocated.  Adding to a linear one writes one
+   entry, which may straddle two sectors and need one allocated,
+   unless it converts DIR.  That writes the first sector, the
+   whole table and the first bucket, allocating all but the first.
+   A linear directory may be converted meanwhile, but the count
+   for converting covers a hashed directory's as well. */
+size_t
+dir_add_credits (const struct dir *dir)
+{
+  struct dir_header h;
+
+  if (read_header (dir, &h))
+    return 3 + DIR_TABLE_SECTORS + inode_grow_credits (dir->inode, 1);
+  return 2 + DIR_TABLE_SECTORS
+         + inode_grow_credits (dir->inode, 1 + DIR_TABLE_SECTORS);
+}
+
+/* Returns the most sectors that dir_remove() may add to a journal
+   transaction: the entry, which may straddle two sectors, and the
+   free map, to release the file if it is not open. */
+size_t
+dir_remove_credits (void)
+{
+  return 2 + free_map_credits ();
+}
+
 /* Removes any entry for NAME in DIR.
    Returns true if successful, false on failure,
    which occurs only if there is no file with the given NAME. */
@@ -193,6 +726,7 @@ dir_remove (struct dir *dir, const char *name)
   ASSERT (name != NULL);
 
   /* Find directory entry. */
+  journal_begin (dir_remove_credits ());
   if (!lookup (dir, name, &e, &ofs))
     goto done;
 
@@ -205,6 +739,7 @@ dir_remove (struct dir *dir, const char *name)
   e.in_use = false;
   if (inode_write_at (dir->inode, &e, sizeof e, ofs) != sizeof e)
     goto done;
+  dentry_invalidate (inode_get_inumber (dir->inode), name);
 
   /* Remove inode. */
   inode_remove (inode);
@@ -212,6 +747,7 @@ dir_remove (struct dir *dir, const char *name)
 
  done:
   inode_close (inode);
+  journal_end ();
   return success;
 }
 
@@ -221,8 +757,36 @@ dir_remove (struct dir *dir, const char *name)
 bool
 dir_readdir (struct dir *dir, char name[NAME_MAX + 1])
 {
+  struct dir_header h;
   struct dir_entry e;
 
+  if (read_header (dir, &h))
+    {
+      /* DIR->POS is the offset of the next entry to look at, with
+         any offset before the first bucket standing for its
+         first entry. */
+      uint32_t b = 0;
+      size_t i = 0;
+
+      if (dir->pos >= DIR_BUCKET_OFS)
+        {
+          b = (dir->pos - DIR_BUCKET_OFS) / BLOCK_SECTOR_SIZE;
+          i = ((dir->pos - bucket_ofs (b))
+               - offsetof (struct dir_bucket, entries)) / sizeof e;
+        }
+      for (; b < h.bucket_cnt; b++, i = 0)
+        for (; i < BUCKET_ENTRIES; i++)
+          if (inode_read_at (dir->inode, &e, sizeof e, entry_ofs (b, i))
+              == sizeof e && e.in_use)
+            {
+              dir->pos = entry_ofs (b, i) + sizeof e;
+              strlcpy (name, e.name, NAME_MAX + 1);
+              return true;
+            }
+      dir->pos = bucket_ofs (h.bucket_cnt);
+      return false;
+    }
+
   while (inode_read_at (dir->inode, &e, sizeof e, dir->pos) == sizeof e)
     {
       dir->pos += sizeof e;
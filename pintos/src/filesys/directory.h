@@ -13,8 +13,11 @@
 
 struct inode;
 
+void dir_init (void);
+
 /* Opening and closing directories. */
 bool dir_create (block_sector_t sector, size_t entry_cnt);
+size_t dir_create_credits (size_t entry_cnt);
 struct dir *dir_open (struct inode *);
 struct dir *dir_open_root (void);
 struct dir *dir_reopen (struct dir *);
@@ -25,6 +28,8 @@ struct inode *dir_get_inode (struct dir *);
 bool dir_lookup (const struct dir *, const char *name, struct inode **);
 bool dir_add (struct dir *, const char *name, block_sector_t);
 bool dir_remove (struct dir *, const char *name);
+size_t dir_add_credits (const struct dir *);
+size_t dir_remove_credits (void);
 bool dir_readdir (struct dir *, char name[NAME_MAX + 1]);
 
 #endif /* filesys/directory.h */
@@ -1,7 +1,14 @@
 #include "filesys/file.h"
 #include <debug.h>
+#include "devices/block.h"
 #include "filesys/inode.h"
 #include "threads/malloc.h"
+#include "threads/synch.h"
+
+/* Read-ahead window, in sectors, when a file is first read
+   sequentially and at most. */
+#define RA_MIN_SECTORS 2
+#define RA_MAX_SECTORS 16
 
 /* An open file. */
 struct file
@@ -9,6 +16,16 @@ struct file
     struct inode *inode;        /* File's inode. */
     off_t pos;                  /* Current position. */
     bool deny_write;            /* Has file_deny_write() been called? */
+    int open_cnt;               /* Number of file_dup() handles + 1. */
+
+    /* Sequential read detection. */
+    off_t ra_next;              /* Where a sequential read would start. */
+    off_t ra_end;               /* End of data already read ahead. */
+    off_t ra_window;            /* Bytes to keep read ahead, 0 if random. */
+
+    /* Guards POS, OPEN_CNT and the read-ahead state, which
+       file_dup() handles in different processes share. */
+    struct lock lock;
   };
 
 /* Opens a file for the given INODE, of which it takes ownership,
@@ -23,6 +40,11 @@ file_open (struct inode *inode)
       file->inode = inode;
       file->pos = 0;
       file->deny_write = false;
+      file->open_cnt = 1;
+      file->ra_next = 0;
+      file->ra_end = 0;
+      file->ra_window = 0;
+      lock_init (&file->lock);
       return file;
     }
   else
@@ -41,11 +63,30 @@ file_reopen (struct file *file)
   return file_open (inode_reopen (file->inode));
 }
 
+/* Returns another handle on FILE itself, sharing its position,
+   as for a file descriptor inherited across fork().  FILE stays
+   open until every handle has been closed. */
+struct file *
+file_dup (struct file *file)
+{
+  lock_acquire (&file->lock);
+  file->open_cnt++;
+  lock_release (&file->lock);
+  return file;
+}
+
 /* Closes FILE. */
 void
 file_close (struct file *file)
 {
-  if (file != NULL)
+  bool last;
+
+  if (file == NULL)
+    return;
+  lock_acquire (&file->lock);
+  last = --file->open_cnt == 0;
+  lock_release (&file->lock);
+  if (last)
     {
       file_allow_write (file);
       inode_close (file->inode);
@@ -60,6 +101,39 @@ file_get_inode (struct file *file)
   return file->inode;
 }
 
+/* Notes that SIZE bytes were just read from FILE at offset OFS.
+   A read that starts where the previous one ended doubles the
+   read-ahead window, up to RA_MAX_SECTORS, and any other read
+   closes it.  While the window is open, the data past OFS + SIZE
+   that it covers is fetched into the buffer cache in the
+   background, so that the next reads find it there.
+   FILE's lock must be held. */
+static void
+read_ahead (struct file *file, off_t ofs, off_t size)
+{
+  off_t end = ofs + size;
+
+  if (size == 0)
+    return;
+  if (ofs != file->ra_next)
+    {
+      file->ra_window = 0;
+      file->ra_end = end;
+    }
+  else if (file->ra_window == 0)
+    file->ra_window = RA_MIN_SECTORS * BLOCK_SECTOR_SIZE;
+  else if (file->ra_window < RA_MAX_SECTORS * BLOCK_SECTOR_SIZE)
+    file->ra_window *= 2;
+  file->ra_next = end;
+
+  if (file->ra_window > 0 && file->ra_end < end + file->ra_window)
+    {
+      off_t start = file->ra_end > end ? file->ra_end : end;
+      inode_read_ahead (file->inode, start, end + file->ra_window - start);
+      file->ra_end = end + file->ra_window;
+    }
+}
+
 /* Reads SIZE bytes from FILE into BUFFER,
    starting at the file's current position.
    Returns the number of bytes actually read,
@@ -68,8 +142,13 @@ file_get_inode (struct file *file)
 off_t
 file_read (struct file *file, void *buffer, off_t size)
 {
-  off_t bytes_read = inode_read_at (file->inode, buffer, size, file->pos);
+  off_t bytes_read;
+
+  lock_acquire (&file->lock);
+  bytes_read = inode_read_at (file->inode, buffer, size, file->pos);
+  read_ahead (file, file->pos, bytes_read);
   file->pos += bytes_read;
+  lock_release (&file->lock);
   return bytes_read;
 }
 
@@ -81,30 +160,36 @@ file_read (struct file *file, void *buffer, off_t size)
 off_t
 file_read_at (struct file *file, void *buffer, off_t size, off_t file_ofs)
 {
-  return inode_read_at (file->inode, buffer, size, file_ofs);
+  off_t bytes_read = inode_read_at (file->inode, buffer, size, file_ofs);
+  lock_acquire (&file->lock);
+  read_ahead (file, file_ofs, bytes_read);
+  lock_release (&file->lock);
+  return bytes_read;
 }
 
 /* Writes SIZE bytes from BUFFER into FILE,
    starting at the file's current position.
    Returns the number of bytes actually written,
-   which may be less than SIZE if end of file is reached.
-   (Normally we'd grow the file in that case, but file growth is
-   not yet implemented.)
-   Advances FILE's position by the number of bytes read. */
+   which may be less than SIZE if the disk is full.
+   Writing past end of file grows the file.
+   Advances FILE's position by the number of bytes written. */
 off_t
 file_write (struct file *file, const void *buffer, off_t size)
 {
-  off_t bytes_written = inode_write_at (file->inode, buffer, size, file->pos);
+  off_t bytes_written;
+
+  lock_acquire (&file->lock);
+  bytes_written = inode_write_at (file->inode, buffer, size, file->pos);
   file->pos += bytes_written;
+  lock_release (&file->lock);
   return bytes_written;
 }
 
 /* Writes SIZE bytes from BUFFER into FILE,
    starting at offset FILE_OFS in the file.
    Returns the number of bytes actually written,
-   which may be less than SIZE if end of file is reached.
-   (Normally we'd grow the file in that case, but file growth is
-   not yet implemented.)
+   which may be less than SIZE if the disk is full.
+   Writing past end of file grows the file.
    The file's current position is unaffected. */
 off_t
 file_write_at (struct file *file, const void *buffer, off_t size,
@@ -113,6 +198,43 @@ file_write_at (struct file *file, const void *buffer, off_t size,
   return inode_write_at (file->inode, buffer, size, file_ofs);
 }
 
+/* Copies SIZE bytes from IN into OUT, starting at each file's
+   current position, without passing through a caller's buffer.
+   Returns the number of bytes actually copied, which may be less
+   than SIZE if end of IN is reached or OUT cannot grow.
+   Advances both files' positions by the number of bytes copied. */
+off_t
+file_copy (struct file *out, struct file *in, off_t size)
+{
+  /* Lock both files in a fixed order, so that two copies between
+     the same pair in opposite directions cannot deadlock. */
+  struct file *first = in < out ? in : out;
+  struct file *second = in < out ? out : in;
+  off_t bytes_copied;
+
+  lock_acquire (&first->lock);
+  if (second != first)
+    lock_acquire (&second->lock);
+  bytes_copied = inode_copy_at (out->inode, out->pos,
+                                in->inode, in->pos, size);
+  in->pos += bytes_copied;
+  if (out != in)
+    out->pos += bytes_copied;
+  if (second != first)
+    lock_release (&second->lock);
+  lock_release (&first->lock);
+  return bytes_copied;
+}
+
+/* Writes FILE's modified data out to disk, returning once it
+   is there. */
+void
+file_sync (struct file *file)
+{
+  ASSERT (file != NULL);
+  inode_sync (file->inode);
+}
+
 /* Prevents write operations on FILE's underlying inode
    until file_allow_write() is called or FILE is closed. */
 void
@@ -155,7 +277,9 @@ file_seek (struct file *file, off_t new_pos)
 {
   ASSERT (file != NULL);
   ASSERT (new_pos >= 0);
+  lock_acquire (&file->lock);
   file->pos = new_pos;
+  lock_release (&file->lock);
 }
 
 /* Returns the current position in FILE as a byte offset from the
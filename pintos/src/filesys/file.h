@@ -8,6 +8,7 @@ struct inode;
 /* Opening and closing files. */
 struct file *file_open (struct inode *);
 struct file *file_reopen (struct file *);
+struct file *file_dup (struct file *);
 void file_close (struct file *);
 struct inode *file_get_inode (struct file *);
 
@@ -16,6 +17,8 @@ off_t file_read (struct file *, void *, off_t);
 off_t file_read_at (struct file *, void *, off_t size, off_t start);
 off_t file_write (struct file *, const void *, off_t);
 off_t file_write_at (struct file *, const void *, off_t size, off_t start);
+off_t file_copy (struct file *out, struct file *in, off_t size);
+void file_sync (struct file *);
 
 /* Preventing writes. */
 void file_deny_write (struct file *);
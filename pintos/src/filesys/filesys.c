@@ -2,14 +2,19 @@
 #include <debug.h>
 #include <stdio.h>
 #include <string.h>
+#include "filesys/cache.h"
 #include "filesys/file.h"
 #include "filesys/free-map.h"
 #include "filesys/inode.h"
 #include "filesys/directory.h"
+#include "filesys/journal.h"
 
 /* Partition that contains the file system. */
 struct block *fs_device;
 
+/* Set by the "-crash" kernel command-line option. */
+bool filesys_crash;
+
 static void do_format (void);
 
 /* Initializes the file system module.
@@ -21,8 +26,11 @@ filesys_init (bool format)
   if (fs_device == NULL)
     PANIC ("No file system device found, can't initialize file system.");
 
+  cache_init ();
   inode_init ();
+  dir_init ();
   free_map_init ();
+  journal_init (format);
 
   if (format)
     do_format ();
@@ -35,7 +43,15 @@ filesys_init (bool format)
 void
 filesys_done (void)
 {
+  if (filesys_crash)
+    {
+      /* Commit, but write nothing back, as if power failed just
+         after, so that the next boot must replay the log. */
+      journal_commit ();
+      return;
+    }
   free_map_close ();
+  journal_done ();
 }
 
 /* Creates a file named NAME with the given INITIAL_SIZE.
@@ -46,14 +62,24 @@ bool
 filesys_create (const char *name, off_t initial_size)
 {
   block_sector_t inode_sector = 0;
-  struct dir *dir = dir_open_root ();
-  bool success = (dir != NULL
-                  && free_map_allocate (1, &inode_sector)
-                  && inode_create (inode_sector, initial_size)
-                  && dir_add (dir, name, inode_sector));
+  struct dir *dir;
+  bool success;
+
+  dir = dir_open_root ();
+  if (dir == NULL)
+    return false;
+
+  /* Allocating the inode's sector writes only the free map, which
+     both counts cover already. */
+  journal_begin (inode_create_credits (initial_size, false)
+                 + dir_add_credits (dir));
+  success = (free_map_allocate (1, &inode_sector)
+             && inode_create (inode_sector, initial_size, false)
+             && dir_add (dir, name, inode_sector));
   if (!success && inode_sector != 0)
     free_map_release (inode_sector, 1);
   dir_close (dir);
+  journal_end ();
 
   return success;
 }
@@ -83,9 +109,14 @@ filesys_open (const char *name)
 bool
 filesys_remove (const char *name)
 {
-  struct dir *dir = dir_open_root ();
-  bool success = dir != NULL && dir_remove (dir, name);
+  struct dir *dir;
+  bool success;
+
+  journal_begin (dir_remove_credits ());
+  dir = dir_open_root ();
+  success = dir != NULL && dir_remove (dir, name);
   dir_close (dir);
+  journal_end ();
 
   return success;
 }
@@ -95,9 +126,14 @@ static void
 do_format (void)
 {
   printf ("Formatting file system...");
+  journal_begin (inode_create_credits (free_map_credits ()
+                                       * BLOCK_SECTOR_SIZE, true)
+                 + dir_create_credits (16));
   free_map_create ();
   if (!dir_create (ROOT_DIR_SECTOR, 16))
     PANIC ("root directory creation failed");
   free_map_close ();
+  journal_end ();
+  journal_commit ();
   printf ("done.\n");
 }
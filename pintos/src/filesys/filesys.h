@@ -8,9 +8,16 @@
 #define FREE_MAP_SECTOR 0       /* Free map file inode sector. */
 #define ROOT_DIR_SECTOR 1       /* Root directory file inode sector. */
 
+/* First sector of the metadata journal. */
+#define JOURNAL_SECTOR 2
+
 /* Block device that contains the file system. */
 struct block *fs_device;
 
+/* If true, filesys_done() leaves the journal for the next boot to
+   replay, for testing recovery. */
+extern bool filesys_crash;
+
 void filesys_init (bool format);
 void filesys_done (void);
 bool filesys_create (const char *name, off_t initial_size);
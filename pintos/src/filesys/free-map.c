@@ -1,52 +1,256 @@
 #include "filesys/free-map.h"
 #include <bitmap.h>
 #include <debug.h>
+#include <round.h>
 #include "filesys/file.h"
 #include "filesys/filesys.h"
 #include "filesys/inode.h"
+#include "filesys/journal.h"
+#include "threads/malloc.h"
+#include "threads/synch.h"
+
+/* Sectors per group: those whose bits share a sector of the free
+   map file. */
+#define GROUP_SECTORS (BLOCK_SECTOR_SIZE * 8)
 
 static struct file *free_map_file;   /* Free map file. */
 static struct bitmap *free_map;      /* Free map, one bit per sector. */
 
+/* Free sectors in each group and in all, so that full groups can
+   be skipped and hopeless requests refused without a scan. */
+static size_t *group_free;
+static size_t free_cnt;
+
+/* Sectors released since the last journal commit.  They may not
+   be allocated again until then, since a crash would undo the
+   release but not whatever the new owner wrote to them. */
+static struct bitmap *released;
+static size_t released_cnt;
+
+/* Released sectors that the log holds copies of, which replay
+   would write back after a crash even once the release commits.
+   They may not be allocated again until the next checkpoint
+   empties the log.  Only metadata is logged, so these are few. */
+static struct bitmap *revoked;
+static size_t revoked_cnt;
+
+/* Where free_map_allocate() looks first: just past the sectors it
+   allocated last. */
+static block_sector_t next_hint;
+
+/* Guards all of the above. */
+static struct lock free_map_lock;
+
+static void count_free (void);
+
 /* Initializes the free map. */
 void
 free_map_init (void)
 {
   free_map = bitmap_create (block_size (fs_device));
-  if (free_map == NULL)
+  released = bitmap_create (block_size (fs_device));
+  revoked = bitmap_create (block_size (fs_device));
+  group_free = malloc (DIV_ROUND_UP (block_size (fs_device), GROUP_SECTORS)
+                       * sizeof *group_free);
+  if (free_map == NULL || released == NULL || revoked == NULL
+      || group_free == NULL)
     PANIC ("bitmap creation failed--file system device is too large");
+  lock_init (&free_map_lock);
   bitmap_mark (free_map, FREE_MAP_SECTOR);
   bitmap_mark (free_map, ROOT_DIR_SECTOR);
+  bitmap_set_multiple (free_map, JOURNAL_SECTOR, JOURNAL_SECTORS, true);
+  count_free ();
+}
+
+/* Recounts the free sectors in each group. */
+static void
+count_free (void)
+{
+  size_t size = bitmap_size (free_map);
+  size_t start;
+
+  free_cnt = 0;
+  for (start = 0; start < size; start += GROUP_SECTORS)
+    {
+      size_t cnt = size - start < GROUP_SECTORS ? size - start : GROUP_SECTORS;
+      group_free[start / GROUP_SECTORS] = bitmap_count (free_map, start, cnt,
+                                                        false);
+      free_cnt += group_free[start / GROUP_SECTORS];
+    }
+}
+
+/* Adds DELTA to the free counts for each of the CNT sectors
+   starting at SECTOR. */
+static void
+adjust_free (block_sector_t sector, size_t cnt, int delta)
+{
+  size_t i;
+
+  for (i = 0; i < cnt; i++)
+    group_free[(sector + i) / GROUP_SECTORS] += delta;
+  free_cnt += delta * (int) cnt;
+}
+
+/* Returns the last sector among the CNT starting at SECTOR that
+   is held back in HELD, which has HELD_CNT bits set, or
+   BITMAP_ERROR if there is none. */
+static size_t
+last_held (const struct bitmap *held, size_t held_cnt,
+           size_t sector, size_t cnt)
+{
+  size_t last = BITMAP_ERROR;
+  size_t i;
+
+  if (held_cnt == 0 || !bitmap_any (held, sector, cnt))
+    return BITMAP_ERROR;
+  for (i = sector; i < sector + cnt; i++)
+    if (bitmap_test (held, i))
+      last = i;
+  return last;
+}
+
+/* Returns the first sector of the first run of CNT free sectors
+   at or after START, none of them held back as released or
+   revoked, or BITMAP_ERROR if there is none. */
+static size_t
+scan (size_t start, size_t cnt)
+{
+  size_t size = bitmap_size (free_map);
+
+  for (;;)
+    {
+      size_t sector, held, last;
+
+      while (start < size && group_free[start / GROUP_SECTORS] == 0)
+        start = ROUND_DOWN (start, GROUP_SECTORS) + GROUP_SECTORS;
+      if (start >= size)
+        return BITMAP_ERROR;
+      sector = bitmap_scan (free_map, start, cnt, false);
+      if (sector == BITMAP_ERROR)
+        return sector;
+      held = last_held (released, released_cnt, sector, cnt);
+      last = last_held (revoked, revoked_cnt, sector, cnt);
+      if (held == BITMAP_ERROR || (last != BITMAP_ERROR && last > held))
+        held = last;
+      if (held == BITMAP_ERROR)
+        return sector;
+      start = held + 1;
+    }
 }
 
 /* Allocates CNT consecutive sectors from the free map and stores
-   the first into *SECTORP.
+   the first into *SECTORP.  Must be called within a journal
+   transaction.
    Returns true if successful, false if not enough consecutive
    sectors were available or if the free_map file could not be
    written. */
 bool
 free_map_allocate (size_t cnt, block_sector_t *sectorp)
 {
-  block_sector_t sector = bitmap_scan_and_flip (free_map, 0, cnt, false);
-  if (sector != BITMAP_ERROR
-      && free_map_file != NULL
-      && !bitmap_write (free_map, free_map_file))
+  bool success = free_map_allocate_near (cnt, next_hint, sectorp);
+  if (success)
+    next_hint = *sectorp + cnt;
+  return success;
+}
+
+/* Like free_map_allocate(), but prefers the first run of CNT
+   free sectors at or after GOAL, so that a file's data can be
+   kept next to what precedes it. */
+bool
+free_map_allocate_near (size_t cnt, block_sector_t goal,
+                        block_sector_t *sectorp)
+{
+  block_sector_t sector = BITMAP_ERROR;
+
+  lock_acquire (&free_map_lock);
+  if (cnt <= free_cnt)
     {
-      bitmap_set_multiple (free_map, sector, cnt, false);
-      sector = BITMAP_ERROR;
+      sector = scan (goal, cnt);
+      if (sector == BITMAP_ERROR && goal > 0)
+        sector = scan (0, cnt);
     }
+  if (sector != BITMAP_ERROR)
+    {
+      bitmap_set_multiple (free_map, sector, cnt, true);
+      if (free_map_file != NULL
+          && !bitmap_write_part (free_map, free_map_file, sector, cnt))
+        {
+          bitmap_set_multiple (free_map, sector, cnt, false);
+          sector = BITMAP_ERROR;
+        }
+      else
+        adjust_free (sector, cnt, -1);
+    }
+  lock_release (&free_map_lock);
+
   if (sector != BITMAP_ERROR)
     *sectorp = sector;
   return sector != BITMAP_ERROR;
 }
 
-/* Makes CNT sectors starting at SECTOR available for use. */
+/* Makes CNT sectors starting at SECTOR available for use, once
+   the running journal transaction commits, or, for those the log
+   holds copies of, at the next checkpoint.  Must be called within
+   a journal operation. */
 void
 free_map_release (block_sector_t sector, size_t cnt)
 {
+  size_t i;
+
+  lock_acquire (&free_map_lock);
   ASSERT (bitmap_all (free_map, sector, cnt));
   bitmap_set_multiple (free_map, sector, cnt, false);
-  bitmap_write (free_map, free_map_file);
+  adjust_free (sector, cnt, 1);
+  for (i = sector; i < sector + cnt; i++)
+    if (journal_logged (i))
+      {
+        bitmap_mark (revoked, i);
+        revoked_cnt++;
+      }
+    else
+      {
+        bitmap_mark (released, i);
+        released_cnt++;
+      }
+  bitmap_write_part (free_map, free_map_file, sector, cnt);
+  lock_release (&free_map_lock);
+}
+
+/* Lets the sectors released so far be allocated again, now that
+   the journal has committed their release. */
+void
+free_map_commit (void)
+{
+  lock_acquire (&free_map_lock);
+  if (released_cnt > 0)
+    {
+      bitmap_set_all (released, false);
+      released_cnt = 0;
+    }
+  lock_release (&free_map_lock);
+}
+
+/* Lets the sectors revoked so far be allocated again, now that
+   the journal has emptied the log. */
+void
+free_map_checkpoint (void)
+{
+  lock_acquire (&free_map_lock);
+  if (revoked_cnt > 0)
+    {
+      bitmap_set_all (revoked, false);
+      revoked_cnt = 0;
+    }
+  lock_release (&free_map_lock);
+}
+
+/* Returns the most sectors of the free map file that allocating
+   and releasing sectors within one journal operation may write:
+   all of them. */
+size_t
+free_map_credits (void)
+{
+  return DIV_ROUND_UP (bitmap_file_size (free_map), BLOCK_SECTOR_SIZE);
 }
 
 /* Opens the free map file and reads it from disk. */
@@ -58,6 +262,7 @@ free_map_open (void)
     PANIC ("can't open free map");
   if (!bitmap_read (free_map, free_map_file))
     PANIC ("can't read free map");
+  count_free ();
 }
 
 /* Writes the free map to disk and closes the free map file. */
@@ -73,7 +278,7 @@ void
 free_map_create (void)
 {
   /* Create inode. */
-  if (!inode_create (FREE_MAP_SECTOR, bitmap_file_size (free_map)))
+  if (!inode_create (FREE_MAP_SECTOR, bitmap_file_size (free_map), true))
     PANIC ("free map creation failed");
 
   /* Write bitmap to file. */
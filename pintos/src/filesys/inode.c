@@ -1,23 +1,74 @@
 #include "filesys/inode.h"
-#include <list.h>
 #include <debug.h>
+#include <hash.h>
 #include <round.h>
+#include <stddef.h>
+#include <stdint.h>
 #include <string.h>
+#include "filesys/cache.h"
 #include "filesys/filesys.h"
 #include "filesys/free-map.h"
+#include "filesys/journal.h"
 #include "threads/malloc.h"
+#include "threads/synch.h"
 
 /* Identifies an inode. */
 #define INODE_MAGIC 0x494e4f44
 
+/* A run of COUNT consecutive file sectors, starting at sector
+   BLOCK within the file, stored in COUNT consecutive disk
+   sectors starting at START.
+
+   In an index node (see struct inode_disk), BLOCK is instead the
+   first file sector covered by a child node, START is the child
+   node's sector, and COUNT is unused.  In memory, a START of 0
+   stands for a hole of COUNT sectors: sector 0 holds the free
+   map's inode, so it is never a data sector. */
+struct extent
+  {
+    uint32_t block;             /* First file sector. */
+    block_sector_t start;       /* First disk sector. */
+    uint32_t count;             /* Number of sectors. */
+  };
+
+/* Entries held in an inode, and in a node sector. */
+#define INODE_EXTENTS 40
+#define NODE_EXTENTS 42
+
+/* Longest possible file, in sectors and bytes. */
+#define MAX_BLOCKS ((uint32_t) (INT32_MAX / BLOCK_SECTOR_SIZE))
+#define MAX_LENGTH ((off_t) (MAX_BLOCKS * BLOCK_SECTOR_SIZE))
+
 /* On-disk inode.
-   Must be exactly BLOCK_SECTOR_SIZE bytes long. */
+   Must be exactly BLOCK_SECTOR_SIZE bytes long.
+
+   A file's data is mapped by an extent tree.  At DEPTH 0, EXTENTS
+   holds the extents themselves, sorted by BLOCK, which suffices
+   for all but badly fragmented files.  At DEPTH N > 0, EXTENTS
+   indexes nodes of depth N - 1, each a sector holding up to
+   NODE_EXTENTS entries in the same form; nodes of depth 0 hold
+   extents.  A full node is split in two, and a full inode moves
+   its entries down into a new node, adding a level.  File
+   sectors not covered by any extent are holes, which read as
+   zeros and are allocated when written. */
 struct inode_disk
   {
-    block_sector_t start;               /* First data sector. */
     off_t length;                       /* File size in bytes. */
     unsigned magic;                     /* Magic number. */
-    uint32_t unused[125];               /* Not used. */
+    uint32_t depth;                     /* Levels of nodes below. */
+    uint32_t extent_cnt;                /* Entries in use in EXTENTS. */
+    struct extent extents[INODE_EXTENTS]; /* Extents or index. */
+    uint32_t meta;                      /* Data is metadata? */
+    uint32_t unused[3];                 /* Not used. */
+  };
+
+/* A node of an extent tree.
+   Must be exactly BLOCK_SECTOR_SIZE bytes long. */
+struct extent_node
+  {
+    uint32_t extent_cnt;                /* Entries in use in EXTENTS. */
+    struct extent extents[NODE_EXTENTS]; /* Extents or index. */
+    uint32_t unused;                    /* Not used. */
   };
 
 /* Returns the number of sectors to allocate for an inode SIZE
@@ -31,46 +82,462 @@ bytes_to_sectors (off_t size)
 /* In-memory inode. */
 struct inode
   {
-    struct list_elem elem;              /* Element in inode list. */
+    struct hash_elem hash_elem;         /* Element in open_inodes. */
     block_sector_t sector;              /* Sector number of disk location. */
     int open_cnt;                       /* Number of openers. */
     bool removed;                       /* True if deleted, false otherwise. */
     int deny_write_cnt;                 /* 0: writes ok, >0: deny writes. */
+    bool loaded;                        /* DATA read in?  Set under LOCK. */
+    struct lock lock;                   /* Guards the extents in DATA. */
     struct inode_disk data;             /* Inode content. */
   };
 
-/* Returns the block device sector that contains byte offset POS
-   within INODE.
-   Returns -1 if INODE does not contain data for a byte at offset
-   POS. */
+static const char zeros[BLOCK_SECTOR_SIZE];
+
+/* Returns the index of the last of the CNT extents in EXTENTS
+   that starts at or before file sector BLOCK, or -1 if there is
+   none. */
+static int
+find_extent (const struct extent *extents, uint32_t cnt, uint32_t block)
+{
+  int lo = 0, hi = cnt;
+
+  /* The answer is LO - 1 once LO == HI. */
+  while (lo < hi)
+    {
+      int mid = (lo + hi) / 2;
+      if (extents[mid].block <= block)
+        lo = mid + 1;
+      else
+        hi = mid;
+    }
+  return lo - 1;
+}
+
+/* Looks up file sector BLOCK among the CNT extents in EXTENTS,
+   the last of which must end before LIMIT.  Stores in *E the
+   extent that contains BLOCK and returns true, or stores the
+   hole that contains it, up to the next extent or LIMIT, and
+   returns false.  If GOAL is nonnull, stores in it the disk
+   sector just past the last extent before BLOCK, or 0. */
+static bool
+search_extents (const struct extent *extents, uint32_t cnt, uint32_t block,
+                uint32_t limit, struct extent *e, block_sector_t *goal)
+{
+  int i = find_extent (extents, cnt, block);
+
+  if (i >= 0 && block - extents[i].block < extents[i].count)
+    {
+      *e = extents[i];
+      return true;
+    }
+  e->block = block;
+  e->start = 0;
+  e->count = (i + 1 < (int) cnt ? extents[i + 1].block : limit) - block;
+  if (goal != NULL)
+    *goal = i >= 0 ? extents[i].start + extents[i].count : 0;
+  return false;
+}
+
+/* Looks up file sector BLOCK of DISK_INODE as search_extents()
+   does. */
+static bool
+extent_find (const struct inode_disk *disk_inode, uint32_t block,
+             struct extent *e, block_sector_t *goal)
+{
+  const struct extent *extents = disk_inode->extents;
+  uint32_t cnt = disk_inode->extent_cnt;
+  uint32_t limit = MAX_BLOCKS;
+  struct extent_node node;
+  uint32_t depth;
+
+  for (depth = disk_inode->depth; depth > 0; depth--)
+    {
+      int i = find_extent (extents, cnt, block);
+      block_sector_t child;
+
+      if (i < 0)
+        i = 0;
+      if ((uint32_t) i + 1 < cnt)
+        limit = extents[i + 1].block;
+      child = extents[i].start;
+      cache_read (child, &node, 0, sizeof node);
+      extents = node.extents;
+      cnt = node.extent_cnt;
+    }
+  return search_extents (extents, cnt, block, limit, e, goal);
+}
+
+/* Adds extent NEW to the *CNT sorted extents in EXTENTS, which
+   has room for MAX.  If MERGE is true and NEW continues the
+   extent before it on disk, grows that extent instead of
+   inserting NEW.  Returns false if EXTENTS is full. */
+static bool
+insert_extent (struct extent *extents, uint32_t *cnt, uint32_t max,
+               const struct extent *new, bool merge)
+{
+  int i = find_extent (extents, *cnt, new->block);
+
+  if (merge && i >= 0 && extents[i].block + extents[i].count == new->block
+      && extents[i].start + extents[i].count == new->start)
+    {
+      extents[i].count += new->count;
+      return true;
+    }
+  if (*cnt >= max)
+    return false;
+  memmove (&extents[i + 2], &extents[i + 1],
+           (*cnt - (i + 1)) * sizeof *extents);
+  extents[i + 1] = *new;
+  ++*cnt;
+  return true;
+}
+
+/* Adds extent NEW, which must lie in a hole, to DISK_INODE.
+
+   Works top down, splitting each full node on the way before
+   descending into it, so that its parent always has room for
+   the new half.  A full inode first moves its entries into a new
+   node, deepening the tree.  The caller must write DISK_INODE
+   back.  Returns false if memory or a node sector cannot be
+   allocated. */
+static bool
+extent_add (struct inode_disk *disk_inode, const struct extent *new)
+{
+  struct extent_node *nodes, *parent, *child;
+  struct extent *extents = disk_inode->extents;
+  uint32_t *cnt = &disk_inode->extent_cnt;
+  uint32_t max = INODE_EXTENTS;
+  block_sector_t parent_sector = 0;
+  uint32_t depth;
+  bool success = false;
+
+  if (disk_inode->depth == 0
+      && insert_extent (extents, cnt, INODE_EXTENTS, new, true))
+    return true;
+
+  nodes = malloc (2 * sizeof *nodes);
+  if (nodes == NULL)
+    return false;
+  parent = &nodes[0];
+  child = &nodes[1];
+
+  if (*cnt == INODE_EXTENTS)
+    {
+      block_sector_t sector;
+
+      if (!free_map_allocate (1, &sector))
+        goto done;
+      memset (child, 0, sizeof *child);
+      child->extent_cnt = *cnt;
+      memcpy (child->extents, extents, *cnt * sizeof *extents);
+      journal_write (sector, child, 0, sizeof *child);
+      extents[0].start = sector;
+      extents[0].count = 0;
+      *cnt = 1;
+      disk_inode->depth++;
+    }
+
+  for (depth = disk_inode->depth; depth > 0; )
+    {
+      int i = find_extent (extents, *cnt, new->block);
+      struct extent *ix = &extents[i < 0 ? 0 : i];
+      block_sector_t child_sector = ix->start;
+      struct extent_node *tmp;
+
+      cache_read (child_sector, child, 0, sizeof *child);
+      if (new->block < ix->block)
+        ix->block = new->block;
+
+      if (depth == 1 && insert_extent (child->extents, &child->extent_cnt,
+                                       NODE_EXTENTS, new, true))
+        {
+          journal_write (child_sector, child, 0, sizeof *child);
+          if (parent_sector != 0)
+            journal_write (parent_sector, parent, 0, sizeof *parent);
+          success = true;
+          break;
+        }
+
+      if (child->extent_cnt == NODE_EXTENTS)
+        {
+          /* Split the child, moving its upper half to a new node
+             after it, and look again. */
+          struct extent upper;
+          uint32_t keep = NODE_EXTENTS / 2;
+
+          if (!free_map_allocate (1, &upper.start))
+            break;
+          upper.block = child->extents[keep].block;
+          upper.count = 0;
+          child->extent_cnt = keep;
+          journal_write (child_sector, child, 0, sizeof *child);
+          child->extent_cnt = NODE_EXTENTS - keep;
+          memmove (child->extents, child->extents + keep,
+                   child->extent_cnt * sizeof *child->extents);
+          journal_write (upper.start, child, 0, sizeof *child);
+          insert_extent (extents, cnt, max, &upper, false);
+          if (parent_sector != 0)
+            journal_write (parent_sector, parent, 0, sizeof *parent);
+          continue;
+        }
+
+      /* Descend into the child. */
+      if (parent_sector != 0)
+        journal_write (parent_sector, parent, 0, sizeof *parent);
+      tmp = parent;
+      parent = child;
+      child = tmp;
+      parent_sector = child_sector;
+      extents = parent->extents;
+      cnt = &parent->extent_cnt;
+      max = NODE_EXTENTS;
+      depth--;
+    }
+
+ done:
+  free (nodes);
+  return success;
+}
+
+/* Allocates disk sectors for up to CNT file sectors of
+   DISK_INODE starting at BLOCK, which must be a hole at least
+   that long, preferring a single run starting at GOAL, and adds
+   them to DISK_INODE as extent *E.  Takes a shorter run if no
+   free run is long enough.  The new sectors are not zeroed.
+   Returns false if the disk is full. */
+static bool
+allocate_run (struct inode_disk *disk_inode, uint32_t block, uint32_t cnt,
+              block_sector_t goal, struct extent *e)
+{
+  ASSERT (cnt > 0);
+
+  while (!free_map_allocate_near (cnt, goal, &e->start))
+    if (cnt == 1)
+      return false;
+    else
+      cnt /= 2;
+  e->block = block;
+  e->count = cnt;
+  if (!extent_add (disk_inode, e))
+    {
+      free_map_release (e->start, cnt);
+      return false;
+    }
+  return true;
+}
+
+/* Releases the extents in the CNT entries in EXTENTS, which
+   index nodes of depth DEPTH - 1 if DEPTH > 0, along with those
+   nodes.  Reads nodes one entry at a time, to keep stack use
+   flat as the tree deepens. */
+static void
+release_extents (const struct extent *extents, uint32_t cnt, uint32_t depth)
+{
+  uint32_t i;
+
+  for (i = 0; i < cnt; i++)
+    if (depth == 0)
+      free_map_release (extents[i].start, extents[i].count);
+    else
+      {
+        block_sector_t node = extents[i].start;
+        uint32_t child_cnt, j;
+
+        cache_read (node, &child_cnt, offsetof (struct extent_node,
+                                                extent_cnt),
+                    sizeof child_cnt);
+        for (j = 0; j < child_cnt; j++)
+          {
+            struct extent child;
+
+            cache_read (node, &child,
+                        offsetof (struct extent_node, extents)
+                        + j * sizeof child, sizeof child);
+            release_extents (&child, 1, depth - 1);
+          }
+        free_map_release (node, 1);
+      }
+}
+
+/* Releases every data and node sector of DISK_INODE. */
+static void
+release_data (struct inode_disk *disk_inode)
+{
+  release_extents (disk_inode->extents, disk_inode->extent_cnt,
+                   disk_inode->depth);
+}
+
+/* Returns the block device sector that holds file sector BLOCK
+   of INODE, or 0 if BLOCK is in a hole.  *E caches the extent or
+   hole that was last looked up, so that a run of sectors costs
+   a single lookup; its COUNT must be 0 initially. */
 static block_sector_t
-byte_to_sector (const struct inode *inode, off_t pos)
+block_to_sector (struct inode *inode, uint32_t block, struct extent *e)
 {
-  ASSERT (inode != NULL);
-  if (pos < inode->data.length)
-    return inode->data.start + pos / BLOCK_SECTOR_SIZE;
+  if (block < e->block || block - e->block >= e->count)
+    {
+      lock_acquire (&inode->lock);
+      extent_find (&inode->data, block, e, NULL);
+      lock_release (&inode->lock);
+    }
+  return e->start != 0 ? e->start + (block - e->block) : 0;
+}
+
+/* Returns the block device sector that will hold file sector
+   BLOCK of INODE, which block_to_sector() found to be in a hole,
+   allocating it, along with as many of the CNT sectors after it
+   as are in the same hole, in one run if possible.  Stores the
+   allocated run in *E and also in *FRESH, as its sectors hold
+   garbage until written.  Returns 0 if the disk is full. */
+static block_sector_t
+allocate_block (struct inode *inode, uint32_t block, uint32_t cnt,
+                struct extent *e, struct extent *fresh)
+{
+  block_sector_t goal;
+  bool success = true;
+
+  journal_begin (inode_grow_credits (inode, 1));
+  lock_acquire (&inode->lock);
+  if (!extent_find (&inode->data, block, e, &goal))
+    {
+      success = allocate_run (&inode->data, block,
+                              cnt < e->count ? cnt : e->count, goal, e);
+      if (success)
+        {
+          *fresh = *e;
+          journal_write (inode->sector, &inode->data, 0, BLOCK_SECTOR_SIZE);
+        }
+    }
+  lock_release (&inode->lock);
+  journal_end ();
+  return success ? e->start + (block - e->block) : 0;
+}
+
+/* Extends INODE to LENGTH bytes, if it is shorter. */
+static void
+extend (struct inode *inode, off_t length)
+{
+  if (length <= inode->data.length)
+    return;
+  journal_begin (1);
+  lock_acquire (&inode->lock);
+  if (length > inode->data.length)
+    {
+      inode->data.length = length;
+      journal_write (inode->sector, &inode->data, 0, BLOCK_SECTOR_SIZE);
+    }
+  lock_release (&inode->lock);
+  journal_end ();
+}
+
+/* Writes SIZE bytes from BUFFER into data SECTOR of INODE,
+   starting at offset OFS within it, through the journal if INODE
+   holds metadata. */
+static void
+write_data (const struct inode *inode, block_sector_t sector,
+            const void *buffer, size_t ofs, size_t size)
+{
+  if (inode->data.meta)
+    journal_write (sector, buffer, ofs, size);
   else
-    return -1;
+    cache_write (sector, buffer, ofs, size);
+}
+
+/* Returns the most sectors that writing SIZE bytes of metadata
+   to INODE at OFFSET may add to a journal transaction: the data
+   sectors, each of which may be a hole to allocate. */
+static size_t
+write_credits (const struct inode *inode, off_t offset, off_t size)
+{
+  size_t sectors = DIV_ROUND_UP (offset % BLOCK_SECTOR_SIZE + size,
+                                 BLOCK_SECTOR_SIZE);
+  return sectors + inode_grow_credits (inode, sectors);
+}
+
+/* Writes CHUNK_SIZE bytes from BUFFER into file sector BLOCK of
+   INODE, at offset SECTOR_OFS within it.  SIZE is the number of
+   bytes the caller still has to write from there on, so that a
+   hole can be filled with a run long enough for all of them.  E
+   and FRESH are as for allocate_block(), the latter also with
+   COUNT 0 initially.  Returns false if the disk is full. */
+static bool
+write_block (struct inode *inode, uint32_t block, int sector_ofs,
+             const void *buffer, int chunk_size, off_t size,
+             struct extent *e, struct extent *fresh)
+{
+  block_sector_t sector = block_to_sector (inode, block, e);
+
+  if (sector == 0)
+    {
+      uint32_t cnt = DIV_ROUND_UP (sector_ofs + size, BLOCK_SECTOR_SIZE);
+      sector = allocate_block (inode, block, cnt, e, fresh);
+      if (sector == 0)
+        return false;
+    }
+
+  /* A new sector gets zeros around a partial chunk. */
+  if (chunk_size < BLOCK_SECTOR_SIZE
+      && block >= fresh->block && block - fresh->block < fresh->count)
+    write_data (inode, sector, zeros, 0, BLOCK_SECTOR_SIZE);
+  write_data (inode, sector, buffer, sector_ofs, chunk_size);
+  return true;
 }
 
-/* List of open inodes, so that opening a single inode twice
-   returns the same `struct inode'. */
-static struct list open_inodes;
+/* Open inodes, keyed by sector, so that opening a single inode
+   twice returns the same `struct inode'. */
+static struct hash open_inodes;
+
+/* Guards open_inodes and the open counts of its inodes. */
+static struct lock open_inodes_lock;
+
+static hash_hash_func inode_hash;
+static hash_less_func inode_less;
 
 /* Initializes the inode module. */
 void
 inode_init (void)
 {
-  list_init (&open_inodes);
+  if (!hash_init (&open_inodes, inode_hash, inode_less, NULL))
+    PANIC ("open inode table creation failed");
+  lock_init (&open_inodes_lock);
+}
+
+/* Returns a hash value for inode I. */
+static unsigned
+inode_hash (const struct hash_elem *i_, void *aux UNUSED)
+{
+  const struct inode *i = hash_entry (i_, struct inode, hash_elem);
+  return hash_int (i->sector);
+}
+
+/* Returns true if inode A precedes inode B. */
+static bool
+inode_less (const struct hash_elem *a_, const struct hash_elem *b_,
+            void *aux UNUSED)
+{
+  const struct inode *a = hash_entry (a_, struct inode, hash_elem);
+  const struct inode *b = hash_entry (b_, struct inode, hash_elem);
+  return a->sector < b->sector;
 }
 
 /* Initializes an inode with LENGTH bytes of data and
    writes the new inode to sector SECTOR on the file system
-   device.
+   device.  The data sectors are allocated now, in as few runs as
+   possible, so that the free map's own file does not grow while
+   it is being written.  If META is true, the data is file system
+   metadata, such as a directory, and is journaled along with the
+   inode itself.
+
+   Allocation stops once the inode's extents are used up, since
+   another run would add a node sector, which
+   inode_create_credits() does not count.  The rest of an
+   ordinary file then stays a hole, to be allocated when written.
    Returns true if successful.
-   Returns false if memory or disk allocation fails. */
+   Returns false if memory or disk allocation fails, or if
+   metadata does not fit in INODE_EXTENTS runs. */
 bool
-inode_create (block_sector_t sector, off_t length)
+inode_create (block_sector_t sector, off_t length, bool meta)
 {
   struct inode_disk *disk_inode = NULL;
   bool success = false;
@@ -80,64 +547,124 @@ inode_create (block_sector_t sector, off_t length)
   /* If this assertion fails, the inode structure is not exactly
      one sector in size, and you should fix that. */
   ASSERT (sizeof *disk_inode == BLOCK_SECTOR_SIZE);
+  ASSERT (sizeof (struct extent_node) == BLOCK_SECTOR_SIZE);
+
+  if (length > MAX_LENGTH)
+    return false;
 
+  journal_begin (inode_create_credits (length, meta));
   disk_inode = calloc (1, sizeof *disk_inode);
   if (disk_inode != NULL)
     {
-      size_t sectors = bytes_to_sectors (length);
+      uint32_t sectors = bytes_to_sectors (length);
+      block_sector_t goal = 0;
+      bool failed = false;
+      struct extent e;
+      uint32_t i;
+
       disk_inode->length = length;
       disk_inode->magic = INODE_MAGIC;
-      if (free_map_allocate (sectors, &disk_inode->start))
+      disk_inode->meta = meta;
+      for (i = 0; i < sectors && disk_inode->extent_cnt < INODE_EXTENTS;
+           i += e.count)
         {
-          block_write (fs_device, sector, disk_inode);
-          if (sectors > 0)
+          if (!allocate_run (disk_inode, i, sectors - i, goal, &e))
             {
-              static char zeros[BLOCK_SECTOR_SIZE];
-              size_t i;
-
-              for (i = 0; i < sectors; i++)
-                block_write (fs_device, disk_inode->start + i, zeros);
+              failed = true;
+              break;
             }
+          goal = e.start + e.count;
+        }
+      if (!failed && (i >= sectors || !meta))
+        {
+          for (i = 0; i < sectors; i++)
+            if (extent_find (disk_inode, i, &e, NULL))
+              {
+                block_sector_t data = e.start + (i - e.block);
+                if (meta)
+                  journal_write (data, zeros, 0, BLOCK_SECTOR_SIZE);
+                else
+                  cache_write (data, zeros, 0, BLOCK_SECTOR_SIZE);
+              }
+          journal_write (sector, disk_inode, 0, BLOCK_SECTOR_SIZE);
           success = true;
         }
+      else
+        release_data (disk_inode);
       free (disk_inode);
     }
+  journal_end ();
   return success;
 }
 
+/* Returns the most sectors that inode_create() may add to a
+   journal transaction for an inode LENGTH bytes long: the inode,
+   the free map, and the data if META. */
+size_t
+inode_create_credits (off_t length, bool meta)
+{
+  return 1 + free_map_credits () + (meta ? bytes_to_sectors (length) : 0);
+}
+
+/* Returns the most sectors, data aside, that allocating RUNS
+   runs of data sectors for INODE within one journal operation
+   may add to its transaction: the inode, the free map, and for
+   each run two node sectors per level of the extent tree.  That
+   counts one level more than the tree has, in case it deepens
+   meanwhile, which may happen only once per operation since the
+   inode is then nearly empty again. */
+size_t
+inode_grow_credits (const struct inode *inode, size_t runs)
+{
+  return 1 + free_map_credits () + runs * 2 * (inode->data.depth + 1);
+}
+
 /* Reads an inode from SECTOR
    and returns a `struct inode' that contains it.
    Returns a null pointer if memory allocation fails. */
 struct inode *
 inode_open (block_sector_t sector)
 {
-  struct list_elem *e;
+  struct hash_elem *e;
   struct inode *inode;
 
-  /* Check whether this inode is already open. */
-  for (e = list_begin (&open_inodes); e != list_end (&open_inodes);
-       e = list_next (e))
+  /* Allocate memory, which also serves as the lookup key. */
+  inode = malloc (sizeof *inode);
+  if (inode == NULL)
+    return NULL;
+  inode->sector = sector;
+
+  /* Check whether this inode is already open.  If another opener
+     is still reading it in, wait for it on the inode's lock. */
+  lock_acquire (&open_inodes_lock);
+  e = hash_insert (&open_inodes, &inode->hash_elem);
+  if (e != NULL)
     {
-      inode = list_entry (e, struct inode, elem);
-      if (inode->sector == sector)
+      free (inode);
+      inode = hash_entry (e, struct inode, hash_elem);
+      inode->open_cnt++;
+      lock_release (&open_inodes_lock);
+      if (!inode->loaded)
         {
-          inode_reopen (inode);
-          return inode;
+          lock_acquire (&inode->lock);
+          lock_release (&inode->lock);
         }
+      return inode;
     }
 
-  /* Allocate memory. */
-  inode = malloc (sizeof *inode);
-  if (inode == NULL)
-    return NULL;
-
-  /* Initialize. */
-  list_push_front (&open_inodes, &inode->elem);
-  inode->sector = sector;
+  /* Initialize, before anyone else can find it, then read it in
+     holding only its own lock, so that opening other inodes need
+     not wait for the disk. */
   inode->open_cnt = 1;
   inode->deny_write_cnt = 0;
   inode->removed = false;
-  block_read (fs_device, inode->sector, &inode->data);
+  inode->loaded = false;
+  lock_init (&inode->lock);
+  lock_acquire (&inode->lock);
+  lock_release (&open_inodes_lock);
+  cache_read (inode->sector, &inode->data, 0, BLOCK_SECTOR_SIZE);
+  inode->loaded = true;
+  lock_release (&inode->lock);
   return inode;
 }
 
@@ -146,7 +673,11 @@ struct inode *
 inode_reopen (struct inode *inode)
 {
   if (inode != NULL)
-    inode->open_cnt++;
+    {
+      lock_acquire (&open_inodes_lock);
+      inode->open_cnt++;
+      lock_release (&open_inodes_lock);
+    }
   return inode;
 }
 
@@ -163,22 +694,29 @@ inode_get_inumber (const struct inode *inode)
 void
 inode_close (struct inode *inode)
 {
+  bool last;
+
   /* Ignore null pointer. */
   if (inode == NULL)
     return;
 
+  /* Remove from the open inode table if this was the last opener. */
+  lock_acquire (&open_inodes_lock);
+  last = --inode->open_cnt == 0;
+  if (last)
+    hash_delete (&open_inodes, &inode->hash_elem);
+  lock_release (&open_inodes_lock);
+
   /* Release resources if this was the last opener. */
-  if (--inode->open_cnt == 0)
+  if (last)
     {
-      /* Remove from inode list and release lock. */
-      list_remove (&inode->elem);
-
       /* Deallocate blocks if removed. */
       if (inode->removed)
         {
+          journal_begin (free_map_credits ());
           free_map_release (inode->sector, 1);
-          free_map_release (inode->data.start,
-                            bytes_to_sectors (inode->data.length));
+          release_data (&inode->data);
+          journal_end ();
         }
 
       free (inode);
@@ -195,6 +733,7 @@ inode_remove (struct inode *inode)
 }
 
 /* Reads SIZE bytes from INODE into BUFFER, starting at position OFFSET.
+   Holes read as zeros.
    Returns the number of bytes actually read, which may be less
    than SIZE if an error occurs or end of file is reached. */
 off_t
@@ -202,12 +741,11 @@ inode_read_at (struct inode *inode, void *buffer_, off_t size, off_t offset)
 {
   uint8_t *buffer = buffer_;
   off_t bytes_read = 0;
-  uint8_t *bounce = NULL;
+  struct extent e = {0, 0, 0};
 
   while (size > 0)
     {
       /* Disk sector to read, starting byte offset within sector. */
-      block_sector_t sector_idx = byte_to_sector (inode, offset);
       int sector_ofs = offset % BLOCK_SECTOR_SIZE;
 
       /* Bytes left in inode, bytes left in sector, lesser of the two. */
@@ -217,106 +755,198 @@ inode_read_at (struct inode *inode, void *buffer_, off_t size, off_t offset)
 
       /* Number of bytes to actually copy out of this sector. */
       int chunk_size = size < min_left ? size : min_left;
+      block_sector_t sector_idx;
       if (chunk_size <= 0)
         break;
 
-      if (sector_ofs == 0 && chunk_size == BLOCK_SECTOR_SIZE)
-        {
-          /* Read full sector directly into caller's buffer. */
-          block_read (fs_device, sector_idx, buffer + bytes_read);
-        }
+      sector_idx = block_to_sector (inode, offset / BLOCK_SECTOR_SIZE, &e);
+      if (sector_idx != 0)
+        cache_read (sector_idx, buffer + bytes_read, sector_ofs, chunk_size);
       else
-        {
-          /* Read sector into bounce buffer, then partially copy
-             into caller's buffer. */
-          if (bounce == NULL)
-            {
-              bounce = malloc (BLOCK_SECTOR_SIZE);
-              if (bounce == NULL)
-                break;
-            }
-          block_read (fs_device, sector_idx, bounce);
-          memcpy (buffer + bytes_read, bounce + sector_ofs, chunk_size);
-        }
+        memset (buffer + bytes_read, 0, chunk_size);
 
       /* Advance. */
       size -= chunk_size;
       offset += chunk_size;
       bytes_read += chunk_size;
     }
-  free (bounce);
 
   return bytes_read;
 }
 
 /* Writes SIZE bytes from BUFFER into INODE, starting at OFFSET.
+   Writing past end of file extends INODE, leaving any gap
+   between the old end and OFFSET as a hole.  The sectors for a
+   hole being written are allocated together, in one run if the
+   free map has one, so that they can later be read back in long
+   runs.
    Returns the number of bytes actually written, which may be
-   less than SIZE if end of file is reached or an error occurs.
-   (Normally a write at end of file would extend the inode, but
-   growth is not yet implemented.) */
+   less than SIZE if the disk is full, the file would exceed the
+   largest possible size, or an error occurs. */
 off_t
 inode_write_at (struct inode *inode, const void *buffer_, off_t size,
                 off_t offset)
 {
   const uint8_t *buffer = buffer_;
   off_t bytes_written = 0;
-  uint8_t *bounce = NULL;
+  struct extent e = {0, 0, 0};
+  struct extent fresh = {0, 0, 0};
 
   if (inode->deny_write_cnt)
     return 0;
+  if (offset >= MAX_LENGTH)
+    return 0;
+  if (size > MAX_LENGTH - offset)
+    size = MAX_LENGTH - offset;
+
+  /* A metadata write is a single operation on the journal.  Other
+     writes are journaled only as far as they change the inode. */
+  if (inode->data.meta)
+    journal_begin (write_credits (inode, offset, size));
 
   while (size > 0)
     {
-      /* Sector to write, starting byte offset within sector. */
-      block_sector_t sector_idx = byte_to_sector (inode, offset);
+      /* Starting byte offset within sector to write. */
       int sector_ofs = offset % BLOCK_SECTOR_SIZE;
 
-      /* Bytes left in inode, bytes left in sector, lesser of the two. */
-      off_t inode_left = inode_length (inode) - offset;
+      /* Bytes left in sector. */
       int sector_left = BLOCK_SECTOR_SIZE - sector_ofs;
-      int min_left = inode_left < sector_left ? inode_left : sector_left;
 
       /* Number of bytes to actually write into this sector. */
-      int chunk_size = size < min_left ? size : min_left;
-      if (chunk_size <= 0)
-        break;
-
-      if (sector_ofs == 0 && chunk_size == BLOCK_SECTOR_SIZE)
-        {
-          /* Write full sector directly to disk. */
-          block_write (fs_device, sector_idx, buffer + bytes_written);
-        }
-      else
-        {
-          /* We need a bounce buffer. */
-          if (bounce == NULL)
-            {
-              bounce = malloc (BLOCK_SECTOR_SIZE);
-              if (bounce == NULL)
-                break;
-            }
+      int chunk_size = size < sector_left ? size : sector_left;
 
-          /* If the sector contains data before or after the chunk
-             we're writing, then we need to read in the sector
-             first.  Otherwise we start with a sector of all zeros. */
-          if (sector_ofs > 0 || chunk_size < sector_left)
-            block_read (fs_device, sector_idx, bounce);
-          else
-            memset (bounce, 0, BLOCK_SECTOR_SIZE);
-          memcpy (bounce + sector_ofs, buffer + bytes_written, chunk_size);
-          block_write (fs_device, sector_idx, bounce);
-        }
+      if (!write_block (inode, offset / BLOCK_SECTOR_SIZE, sector_ofs,
+                        buffer + bytes_written, chunk_size, size,
+                        &e, &fresh))
+        break;
 
       /* Advance. */
       size -= chunk_size;
       offset += chunk_size;
       bytes_written += chunk_size;
     }
-  free (bounce);
+
+  /* Only now make the new data visible to readers. */
+  if (bytes_written > 0)
+    extend (inode, offset);
+  if (inode->data.meta)
+    journal_end ();
 
   return bytes_written;
 }
 
+/* Asks for the sectors holding the SIZE bytes of INODE starting
+   at OFFSET to be read into the buffer cache in the background,
+   an extent at a time.  Bytes past the end of INODE and holes
+   are ignored. */
+void
+inode_read_ahead (struct inode *inode, off_t offset, off_t size)
+{
+  struct extent e = {0, 0, 0};
+  off_t end = offset + size;
+  uint32_t block, end_block;
+
+  if (end > inode_length (inode))
+    end = inode_length (inode);
+  block = offset / BLOCK_SECTOR_SIZE;
+  end_block = DIV_ROUND_UP (end, BLOCK_SECTOR_SIZE);
+  while (block < end_block)
+    {
+      block_sector_t sector = block_to_sector (inode, block, &e);
+      uint32_t cnt = e.count - (block - e.block);
+
+      if (cnt > end_block - block)
+        cnt = end_block - block;
+      if (sector != 0)
+        cache_read_ahead (sector, cnt);
+      block += cnt;
+    }
+}
+
+/* Copies SIZE bytes from SRC, starting at SRC_OFS, into DST,
+   starting at DST_OFS, sector by sector through the buffer cache.
+   DST grows as it does for inode_write_at().
+   Returns the number of bytes actually copied, which may be less
+   than SIZE if end of SRC is reached or an error occurs.
+   The ranges must not overlap if SRC and DST are the same inode. */
+off_t
+inode_copy_at (struct inode *dst, off_t dst_ofs,
+               struct inode *src, off_t src_ofs, off_t size)
+{
+  off_t bytes_copied = 0;
+  struct extent src_e = {0, 0, 0};
+  struct extent dst_e = {0, 0, 0};
+  struct extent fresh = {0, 0, 0};
+  uint8_t *buf;
+
+  if (dst->deny_write_cnt || dst_ofs >= MAX_LENGTH)
+    return 0;
+  if (size > MAX_LENGTH - dst_ofs)
+    size = MAX_LENGTH - dst_ofs;
+
+  buf = malloc (BLOCK_SECTOR_SIZE);
+  if (buf == NULL)
+    return 0;
+  if (dst->data.meta)
+    journal_begin (write_credits (dst, dst_ofs, size));
+
+  while (size > 0)
+    {
+      /* Sector to copy from, starting byte offsets within sectors. */
+      block_sector_t src_idx;
+      int src_sector_ofs = src_ofs % BLOCK_SECTOR_SIZE;
+      int dst_sector_ofs = dst_ofs % BLOCK_SECTOR_SIZE;
+
+      /* Bytes left in SRC or either sector, least of all. */
+      off_t src_left = inode_length (src) - src_ofs;
+      int src_sector_left = BLOCK_SECTOR_SIZE - src_sector_ofs;
+      int dst_sector_left = BLOCK_SECTOR_SIZE - dst_sector_ofs;
+      off_t chunk_size = size;
+      if (src_left < chunk_size)
+        chunk_size = src_left;
+      if (src_sector_left < chunk_size)
+        chunk_size = src_sector_left;
+      if (dst_sector_left < chunk_size)
+        chunk_size = dst_sector_left;
+      if (chunk_size <= 0)
+        break;
+
+      src_idx = block_to_sector (src, src_ofs / BLOCK_SECTOR_SIZE, &src_e);
+      if (src_idx != 0)
+        cache_read (src_idx, buf, src_sector_ofs, chunk_size);
+      else
+        memset (buf, 0, chunk_size);
+      if (!write_block (dst, dst_ofs / BLOCK_SECTOR_SIZE, dst_sector_ofs,
+                        buf, chunk_size, size < src_left ? size : src_left,
+                        &dst_e, &fresh))
+        break;
+
+      /* Advance. */
+      size -= chunk_size;
+      src_ofs += chunk_size;
+      dst_ofs += chunk_size;
+      bytes_copied += chunk_size;
+    }
+  free (buf);
+  if (bytes_copied > 0)
+    extend (dst, dst_ofs);
+  if (dst->data.meta)
+    journal_end ();
+
+  return bytes_copied;
+}
+
+/* Writes INODE's dirty sectors in the buffer cache to disk,
+   committing the journal first so that its metadata may go too.
+   The cache does not track which inode a sector belongs to, so
+   this writes back every dirty sector. */
+void
+inode_sync (struct inode *inode UNUSED)
+{
+  journal_commit ();
+  cache_flush ();
+}
+
 /* Disables writes to INODE.
    May be called at most once per inode opener. */
 void
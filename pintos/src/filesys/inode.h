@@ -2,13 +2,17 @@
 #define FILESYS_INODE_H
 
 #include <stdbool.h>
+#include <stddef.h>
 #include "filesys/off_t.h"
 #include "devices/block.h"
 
 struct bitmap;
+struct inode;
 
 void inode_init (void);
-bool inode_create (block_sector_t, off_t);
+bool inode_create (block_sector_t, off_t, bool meta);
+size_t inode_create_credits (off_t, bool meta);
+size_t inode_grow_credits (const struct inode *, size_t runs);
 struct inode *inode_open (block_sector_t);
 struct inode *inode_reopen (struct inode *);
 block_sector_t inode_get_inumber (const struct inode *);
@@ -16,6 +20,10 @@ void inode_close (struct inode *);
 void inode_remove (struct inode *);
 off_t inode_read_at (struct inode *, void *, off_t size, off_t offset);
 off_t inode_write_at (struct inode *, const void *, off_t size, off_t offset);
+void inode_read_ahead (struct inode *, off_t offset, off_t size);
+off_t inode_copy_at (struct inode *dst, off_t dst_ofs,
+                     struct inode *src, off_t src_ofs, off_t size);
+void inode_sync (struct inode *);
 void inode_deny_write (struct inode *);
 void inode_allow_write (struct inode *);
 off_t inode_length (const struct inode *);
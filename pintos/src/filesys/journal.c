@@ -0,0 +1,434 @@
+#include "filesys/journal.h"
+#include <bitmap.h>
+#include <debug.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include "devices/timer.h"
+#include "filesys/cache.h"
+#include "filesys/filesys.h"
+#include "filesys/free-map.h"
+#include "threads/malloc.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+
+/* Metadata journal.
+
+   Inodes, extent tree nodes, directories and the free map are
+   only ever modified inside a transaction, with journal_write().
+   Each operation that modifies them brackets its writes with
+   journal_begin() and journal_end(), which nest, and all the
+   operations that run between two commits join a single
+   transaction.  Its sectors are pinned in the buffer cache until
+   the transaction is committed: their new contents are written
+   to the log, followed by a commit record.  Only then may they
+   reach their home locations, so after a crash the file system
+   is always as of the end of some committed transaction, once
+   the log has been replayed by journal_init().
+
+   A transaction is committed when it grows to txn_limit sectors,
+   every COMMIT_INTERVAL ticks by the journal thread, and when
+   journal_commit() is called, so that the metadata writes of
+   many operations cost a few sequential log writes, and a sector
+   written over and over is logged once per commit.
+
+   Pinned sectors cannot be evicted, so a transaction must never
+   outgrow the buffer cache, nor even most of it.  Each operation
+   therefore names, when it begins, the most sectors it may add
+   to the transaction, its credits, and it is admitted only once
+   the transaction's sectors plus the credits of every running
+   operation, its own included, fit in txn_max.  A sector added
+   uses up one of the credits of the operation that adds it, and
+   an operation that runs out panics the kernel: its count was
+   wrong.
+
+   The log is the JOURNAL_SECTORS - 1 sectors after the journal
+   header at JOURNAL_SECTOR.  A transaction is written there as a
+   descriptor record, listing the home sectors of the data that
+   follows it, the data, and a commit record, each a sector.
+   Transactions are appended one after another.  Once too little
+   room is left for another, every sector in the cache is written
+   home, a checkpoint, and the log starts over at its beginning.
+   Sequence numbers, kept in the header and both records, tell
+   the transactions since the last checkpoint from stale ones.
+
+   Replay writes every sector logged since the last checkpoint
+   back home, so a metadata sector that is freed in the meantime
+   must not be reused, say for file data, which is not logged and
+   which replay would then overwrite.  The free map asks
+   journal_logged() which sectors those are and holds them back
+   until the next checkpoint. */
+
+#define JOURNAL_MAGIC 0x4c4e524a        /* Journal header. */
+#define DESC_MAGIC 0x43534544           /* Descriptor record. */
+#define COMMIT_MAGIC 0x544d4d43         /* Commit record. */
+
+/* Sectors in the log proper. */
+#define LOG_SECTORS (JOURNAL_SECTORS - 1)
+
+/* Most sectors in a transaction: those a descriptor can list. */
+#define TXN_MAX 125
+
+/* Ticks between commits by the journal thread. */
+#define COMMIT_INTERVAL TIMER_FREQ
+
+/* Journal header, at JOURNAL_SECTOR.
+   Must be exactly BLOCK_SECTOR_SIZE bytes long. */
+struct journal_header
+  {
+    uint32_t magic;                     /* JOURNAL_MAGIC. */
+    uint32_t seq;                       /* First transaction in log. */
+    uint32_t unused[126];               /* Not used. */
+  };
+
+/* Descriptor or commit record.
+   Must be exactly BLOCK_SECTOR_SIZE bytes long. */
+struct log_record
+  {
+    uint32_t magic;                     /* DESC_MAGIC or COMMIT_MAGIC. */
+    uint32_t seq;                       /* Transaction sequence number. */
+    uint32_t cnt;                       /* Number of data sectors. */
+    block_sector_t sectors[TXN_MAX];    /* Their homes, in a descriptor. */
+  };
+
+/* Running transaction. */
+static block_sector_t txn[TXN_MAX];     /* Home sectors written. */
+static size_t txn_cnt;                  /* Number of sectors in TXN. */
+static size_t txn_limit;                /* Size that forces a commit. */
+static size_t txn_max;                  /* Most sectors it may pin. */
+static size_t reserved;                 /* Credits held by operations. */
+static uint32_t txn_seq;                /* Its sequence number. */
+static int handle_cnt;                  /* Operations still running. */
+static bool commit_wanted;              /* Hold off new operations? */
+
+/* Log offset where the running transaction will be written. */
+static size_t log_head;
+
+/* Sectors written in any transaction since the last checkpoint,
+   the running one included. */
+static struct bitmap *logged;
+
+/* Buffers for a record and a data sector. */
+static struct log_record *record;
+static uint8_t *buffer;
+
+/* Guards all of the above.  Held throughout a commit. */
+static struct lock journal_lock;
+
+/* An operation ended, or a commit just finished. */
+static struct condition journal_idle;
+
+static thread_func committer;
+static void recover (void);
+static void write_header (void);
+
+/* Initializes the journal, creating an empty one if FORMAT is
+   true or replaying the one on disk otherwise, and starts the
+   journal thread.  Must be called before any file system
+   metadata is read. */
+void
+journal_init (bool format)
+{
+  ASSERT (sizeof (struct journal_header) == BLOCK_SECTOR_SIZE);
+  ASSERT (sizeof (struct log_record) == BLOCK_SECTOR_SIZE);
+
+  lock_init (&journal_lock);
+  cond_init (&journal_idle);
+  record = malloc (sizeof *record);
+  buffer = malloc (BLOCK_SECTOR_SIZE);
+  logged = bitmap_create (block_size (fs_device));
+  if (record == NULL || buffer == NULL || logged == NULL)
+    PANIC ("could not allocate journal buffers");
+
+  /* Pin half of the cache at most, and commit once a transaction
+     pins half of that, to leave room for operations that begin
+     before the commit. */
+  txn_max = cache_size / 2;
+  if (txn_max > TXN_MAX)
+    txn_max = TXN_MAX;
+  if (txn_max == 0)
+    PANIC ("buffer cache too small for the journal");
+  txn_limit = txn_max / 2;
+  if (txn_limit == 0)
+    txn_limit = 1;
+
+  if (format)
+    {
+      /* Clear the log, so that no stale record can look like it
+         belongs to the new one. */
+      size_t i;
+
+      memset (buffer, 0, BLOCK_SECTOR_SIZE);
+      for (i = 0; i < LOG_SECTORS; i++)
+        block_write (fs_device, JOURNAL_SECTOR + 1 + i, buffer);
+      txn_seq = 0;
+      write_header ();
+    }
+  else
+    recover ();
+
+  if (thread_create ("journal", PRI_DEFAULT, committer, NULL) == TID_ERROR)
+    PANIC ("could not start journal thread");
+}
+
+/* Journal thread.  Commits the running transaction
+   periodically. */
+static void
+committer (void *aux UNUSED)
+{
+  for (;;)
+    {
+      timer_sleep (COMMIT_INTERVAL);
+      journal_commit ();
+    }
+}
+
+/* Returns the device sector at offset OFS in the log. */
+static block_sector_t
+log_sector (size_t ofs)
+{
+  ASSERT (ofs < LOG_SECTORS);
+  return JOURNAL_SECTOR + 1 + ofs;
+}
+
+/* Writes a journal header for an empty log that starts with
+   transaction txn_seq, and resets log_head to match. */
+static void
+write_header (void)
+{
+  struct journal_header *h = (struct journal_header *) buffer;
+
+  memset (h, 0, sizeof *h);
+  h->magic = JOURNAL_MAGIC;
+  h->seq = txn_seq;
+  block_write (fs_device, JOURNAL_SECTOR, h);
+  log_head = 0;
+}
+
+/* Writes every committed transaction in the log to its home
+   sectors, then empties the log. */
+static void
+recover (void)
+{
+  struct journal_header *h = (struct journal_header *) buffer;
+  struct log_record *commit = (struct log_record *) buffer;
+  size_t replayed = 0;
+  size_t pos = 0;
+
+  block_read (fs_device, JOURNAL_SECTOR, h);
+  if (h->magic != JOURNAL_MAGIC)
+    PANIC ("no journal on file system device--reformat it");
+  txn_seq = h->seq;
+
+  while (pos + 2 <= LOG_SECTORS)
+    {
+      size_t cnt, i;
+
+      /* Stop at the first transaction that is not complete. */
+      block_read (fs_device, log_sector (pos), record);
+      cnt = record->cnt;
+      if (record->magic != DESC_MAGIC || record->seq != txn_seq
+          || cnt > TXN_MAX || pos + cnt + 2 > LOG_SECTORS)
+        break;
+      block_read (fs_device, log_sector (pos + cnt + 1), commit);
+      if (commit->magic != COMMIT_MAGIC || commit->seq != txn_seq
+          || commit->cnt != cnt)
+        break;
+
+      for (i = 0; i < cnt; i++)
+        {
+          block_read (fs_device, log_sector (pos + 1 + i), buffer);
+          block_write (fs_device, record->sectors[i], buffer);
+        }
+      pos += cnt + 2;
+      txn_seq++;
+      replayed++;
+    }
+
+  if (replayed > 0)
+    printf ("Journal: replayed %zu transactions\n", replayed);
+  write_header ();
+}
+
+/* Writes back every sector in the cache, so that nothing in the
+   log is needed any more, and starts the log over.
+   journal_lock must be held and no transaction may be running. */
+static void
+checkpoint (void)
+{
+  cache_flush ();
+  write_header ();
+  bitmap_set_all (logged, false);
+  free_map_checkpoint ();
+}
+
+/* Commits the running transaction, if it has any sectors.
+   journal_lock must be held and no operations may be running. */
+static void
+commit_locked (void)
+{
+  size_t i;
+
+  ASSERT (handle_cnt == 0);
+
+  commit_wanted = false;
+  if (txn_cnt > 0)
+    {
+      ASSERT (log_head + txn_cnt + 2 <= LOG_SECTORS);
+
+      /* Descriptor, data, then commit record, in that order. */
+      memset (record, 0, sizeof *record);
+      record->magic = DESC_MAGIC;
+      record->seq = txn_seq;
+      record->cnt = txn_cnt;
+      memcpy (record->sectors, txn, txn_cnt * sizeof *txn);
+      block_write (fs_device, log_sector (log_head), record);
+      for (i = 0; i < txn_cnt; i++)
+        {
+          cache_read (txn[i], buffer, 0, BLOCK_SECTOR_SIZE);
+          block_write (fs_device, log_sector (log_head + 1 + i), buffer);
+        }
+      memset (record, 0, sizeof *record);
+      record->magic = COMMIT_MAGIC;
+      record->seq = txn_seq;
+      record->cnt = txn_cnt;
+      block_write (fs_device, log_sector (log_head + txn_cnt + 1), record);
+
+      /* The sectors may go home now, and the sectors released in
+         the transaction be reused. */
+      for (i = 0; i < txn_cnt; i++)
+        cache_unpin (txn[i]);
+      free_map_commit ();
+
+      log_head += txn_cnt + 2;
+      txn_seq++;
+      txn_cnt = 0;
+      if (LOG_SECTORS - log_head < TXN_MAX + 2)
+        checkpoint ();
+    }
+  cond_broadcast (&journal_idle, &journal_lock);
+}
+
+/* Commits the running transaction, waiting for the operations
+   in it to finish first.  Must not be called within one. */
+void
+journal_commit (void)
+{
+  ASSERT (thread_current ()->journal_depth == 0);
+
+  lock_acquire (&journal_lock);
+  commit_wanted = true;
+  while (handle_cnt > 0)
+    cond_wait (&journal_idle, &journal_lock);
+  commit_locked ();
+  lock_release (&journal_lock);
+}
+
+/* Commits the running transaction and writes everything back, so
+   that the log is empty at the next journal_init(). */
+void
+journal_done (void)
+{
+  lock_acquire (&journal_lock);
+  while (handle_cnt > 0)
+    cond_wait (&journal_idle, &journal_lock);
+  commit_locked ();
+  checkpoint ();
+  lock_release (&journal_lock);
+}
+
+/* Starts an operation that modifies file system metadata, which
+   joins the running transaction, and which may add at most
+   CREDITS sectors to it.  Calls nest: only the outermost pair
+   counts, so its CREDITS must cover those of the calls within.
+   Waits first if the running transaction is full, about to be
+   committed, or cannot hold CREDITS more sectors.  An operation
+   that may need more than txn_max runs alone and gets all of
+   it. */
+void
+journal_begin (size_t credits)
+{
+  struct thread *t = thread_current ();
+
+  if (t->journal_depth++ > 0)
+    return;
+
+  if (credits > txn_max)
+    credits = txn_max;
+  lock_acquire (&journal_lock);
+  while (commit_wanted || txn_cnt >= txn_limit
+         || txn_cnt + reserved + credits > txn_max)
+    if (handle_cnt == 0)
+      commit_locked ();
+    else
+      cond_wait (&journal_idle, &journal_lock);
+  handle_cnt++;
+  reserved += credits;
+  t->journal_credits = credits;
+  lock_release (&journal_lock);
+}
+
+/* Ends an operation started with journal_begin(), returning the
+   credits it did not use. */
+void
+journal_end (void)
+{
+  struct thread *t = thread_current ();
+
+  ASSERT (t->journal_depth > 0);
+  if (--t->journal_depth > 0)
+    return;
+
+  lock_acquire (&journal_lock);
+  reserved -= t->journal_credits;
+  t->journal_credits = 0;
+  handle_cnt--;
+  cond_broadcast (&journal_idle, &journal_lock);
+  lock_release (&journal_lock);
+}
+
+/* Writes SIZE bytes from BUFFER_ into metadata SECTOR, starting
+   at offset OFS within it, as part of the running transaction.
+   Must be called within an operation. */
+void
+journal_write (block_sector_t sector, const void *buffer_, size_t ofs,
+               size_t size)
+{
+  struct thread *t = thread_current ();
+  size_t i;
+
+  ASSERT (t->journal_depth > 0);
+
+  cache_write_pinned (sector, buffer_, ofs, size);
+
+  lock_acquire (&journal_lock);
+  for (i = 0; i < txn_cnt; i++)
+    if (txn[i] == sector)
+      break;
+  if (i == txn_cnt)
+    {
+      if (t->journal_credits == 0)
+        PANIC ("journal operation exceeded its credits");
+      t->journal_credits--;
+      reserved--;
+      ASSERT (txn_cnt < txn_max);
+      txn[txn_cnt++] = sector;
+      bitmap_mark (logged, sector);
+    }
+  lock_release (&journal_lock);
+}
+
+/* Returns true if replaying the log after a crash could write
+   SECTOR, because it was written in a transaction since the last
+   checkpoint.  Must be called within an operation, which keeps a
+   checkpoint from clearing the answer meanwhile.  Does not take
+   journal_lock, so that the free map may call it holding its own
+   lock: only an operation that writes SECTOR changes its bit
+   otherwise. */
+bool
+journal_logged (block_sector_t sector)
+{
+  ASSERT (thread_current ()->journal_depth > 0);
+
+  return bitmap_test (logged, sector);
+}
@@ -0,0 +1,20 @@
+#ifndef FILESYS_JOURNAL_H
+#define FILESYS_JOURNAL_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include "devices/block.h"
+
+/* Sectors reserved for the journal, starting at JOURNAL_SECTOR. */
+#define JOURNAL_SECTORS 256
+
+void journal_init (bool format);
+void journal_done (void);
+void journal_begin (size_t credits);
+void journal_end (void);
+void journal_write (block_sector_t, const void *buffer, size_t ofs,
+                    size_t size);
+void journal_commit (void);
+bool journal_logged (block_sector_t);
+
+#endif /* filesys/journal.h */
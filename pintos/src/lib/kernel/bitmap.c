@@ -69,6 +69,36 @@ last_mask (const struct bitmap *b)
   return last_bits ? ((elem_type) 1 << last_bits) - 1 : (elem_type) -1;
 }
 
+/* Returns the index of the first bit in B at or after START that
+   is set to VALUE, or B's size if there is none.  Examines a
+   whole element at a time, using BSF to find the bit within the
+   element that has one. */
+static size_t
+next_bit (const struct bitmap *b, size_t start, bool value)
+{
+  elem_type flip = value ? 0 : (elem_type) -1;
+  size_t idx = elem_idx (start);
+  elem_type bits;
+  size_t bit;
+
+  if (start >= b->bit_cnt)
+    return b->bit_cnt;
+
+  /* Turn the bits equal to VALUE on, ignoring those before
+     START. */
+  bits = (b->bits[idx] ^ flip) & ((elem_type) -1 << (start % ELEM_BITS));
+  while (bits == 0)
+    {
+      if (++idx >= elem_cnt (b->bit_cnt))
+        return b->bit_cnt;
+      bits = b->bits[idx] ^ flip;
+    }
+  asm ("bsfl %1, %0" : "=r" (bit) : "rm" (bits) : "cc");
+
+  bit += idx * ELEM_BITS;
+  return bit < b->bit_cnt ? bit : b->bit_cnt;
+}
+
 /* Creation and destruction. */
 
 /* Creates and returns a pointer to a newly allocated bitmap with room for
@@ -250,16 +280,11 @@ bitmap_count (const struct bitmap *b, size_t start, size_t cnt, bool value)
 bool
 bitmap_contains (const struct bitmap *b, size_t start, size_t cnt, bool value)
 {
-  size_t i;
-
   ASSERT (b != NULL);
   ASSERT (start <= b->bit_cnt);
   ASSERT (start + cnt <= b->bit_cnt);
 
-  for (i = 0; i < cnt; i++)
-    if (bitmap_test (b, start + i) == value)
-      return true;
-  return false;
+  return next_bit (b, start, value) < start + cnt;
 }
 
 /* Returns true if any bits in B between START and START + CNT,
@@ -295,16 +320,27 @@ bitmap_all (const struct bitmap *b, size_t start, size_t cnt)
 size_t
 bitmap_scan (const struct bitmap *b, size_t start, size_t cnt, bool value)
 {
+  size_t i = start;
+
   ASSERT (b != NULL);
   ASSERT (start <= b->bit_cnt);
 
-  if (cnt <= b->bit_cnt)
+  if (cnt == 0)
+    return start;
+
+  /* Hop from each run of bits set to VALUE to the next, rather
+     than retrying at every bit of a run that is too short. */
+  while (cnt <= b->bit_cnt - i)
     {
-      size_t last = b->bit_cnt - cnt;
-      size_t i;
-      for (i = start; i <= last; i++)
-        if (!bitmap_contains (b, i, cnt, !value))
-          return i;
+      size_t end;
+
+      i = next_bit (b, i, value);
+      if (cnt > b->bit_cnt - i)
+        break;
+      end = next_bit (b, i, !value);
+      if (end - i >= cnt)
+        return i;
+      i = end;
     }
   return BITMAP_ERROR;
 }
@@ -358,6 +394,23 @@ bitmap_write (const struct bitmap *b, struct file *file)
   off_t size = byte_cnt (b->bit_cnt);
   return file_write_at (file, b->bits, size, 0) == size;
 }
+
+/* Writes just the bytes of B that hold the CNT bits starting at
+   START to FILE, which must already hold the rest of B.  Return
+   true if successful, false otherwise. */
+bool
+bitmap_write_part (const struct bitmap *b, struct file *file,
+                   size_t start, size_t cnt)
+{
+  off_t ofs = start / CHAR_BIT;
+  off_t size = DIV_ROUND_UP (start + cnt, CHAR_BIT) - ofs;
+
+  ASSERT (start <= b->bit_cnt);
+  ASSERT (start + cnt <= b->bit_cnt);
+
+  return (file_write_at (file, (const uint8_t *) b->bits + ofs, size, ofs)
+          == size);
+}
 #endif /* FILESYS */
 
 /* Debugging. */
@@ -0,0 +1,20 @@
+#ifndef __LIB_POLL_H
+#define __LIB_POLL_H
+
+/* Events for poll().  POLLIN and POLLOUT may be requested in
+   EVENTS; any of them may be reported in REVENTS. */
+#define POLLIN 0x01             /* Data may be read without blocking. */
+#define POLLOUT 0x04            /* Data may be written without blocking. */
+#define POLLERR 0x08            /* Writing to a pipe with no reader. */
+#define POLLHUP 0x10            /* Reading from a pipe with no writer. */
+#define POLLNVAL 0x20           /* Descriptor not open. */
+
+/* One descriptor to poll. */
+struct pollfd
+  {
+    int fd;                     /* Descriptor, ignored if negative. */
+    short events;               /* Events of interest. */
+    short revents;              /* Events that occurred. */
+  };
+
+#endif /* lib/poll.h */
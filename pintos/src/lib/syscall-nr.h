@@ -29,7 +29,22 @@ enum
     SYS_MKDIR,                  /* Create a directory. */
     SYS_READDIR,                /* Reads a directory entry. */
     SYS_ISDIR,                  /* Tests if a fd represents a directory. */
-    SYS_INUMBER                 /* Returns the inode number for a fd. */
+    SYS_INUMBER,                /* Returns the inode number for a fd. */
+
+    /* Extensions. */
+    SYS_FORK,                   /* Duplicate this process. */
+    SYS_SYSCALL_STATS,          /* Get system call statistics. */
+    SYS_PREAD,                  /* Read from a file at an offset. */
+    SYS_PWRITE,                 /* Write to a file at an offset. */
+    SYS_READV,                  /* Read into several buffers. */
+    SYS_WRITEV,                 /* Write from several buffers. */
+    SYS_COPY_FILE_RANGE,        /* Copy between files in the kernel. */
+    SYS_PIPE,                   /* Create a pipe. */
+    SYS_POLL,                   /* Wait for events on descriptors. */
+    SYS_SHM_CREATE,             /* Create a shared-memory segment. */
+    SYS_SHM_ATTACH,             /* Map a shared-memory segment. */
+    SYS_SHM_DETACH,             /* Unmap a shared-memory segment. */
+    SYS_FSYNC                   /* Write a file's data to disk. */
   };
 
 #endif /* lib/syscall-nr.h */
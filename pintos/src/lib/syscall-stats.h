@@ -0,0 +1,23 @@
+#ifndef __LIB_SYSCALL_STATS_H
+#define __LIB_SYSCALL_STATS_H
+
+#include <stdint.h>
+
+/* Latency histogram buckets.  Bucket I counts the calls that took
+   from 2**(I + SYSCALL_HIST_SHIFT) to 2**(I + SYSCALL_HIST_SHIFT + 1)
+   - 1 CPU cycles.  The first bucket also counts faster calls and
+   the last one slower calls. */
+#define SYSCALL_HIST_CNT 16
+#define SYSCALL_HIST_SHIFT 8
+
+/* Statistics for one system call, as returned by the
+   syscall_stats() system call.  Times are in CPU cycles, as
+   measured by the time-stamp counter. */
+struct syscall_stats
+  {
+    uint64_t count;                     /* Number of calls. */
+    uint64_t cycles;                    /* Total cycles in returned calls. */
+    uint32_t hist[SYSCALL_HIST_CNT];    /* Latency histogram. */
+  };
+
+#endif /* lib/syscall-stats.h */
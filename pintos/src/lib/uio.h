@@ -0,0 +1,16 @@
+#ifndef __LIB_UIO_H
+#define __LIB_UIO_H
+
+#include <stddef.h>
+
+/* Maximum number of buffers passed to readv() or writev(). */
+#define IOV_MAX 32
+
+/* One buffer of a vectored read or write. */
+struct iovec
+  {
+    void *iov_base;             /* Start of buffer. */
+    size_t iov_len;             /* Size of buffer in bytes. */
+  };
+
+#endif /* lib/uio.h */
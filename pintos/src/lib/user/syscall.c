@@ -3,17 +3,60 @@
 #include <syscall.h>
 #include "../syscall-nr.h"
 
+/* System call entry.
+
+   Each system call pushes its arguments and number and then
+   calls through syscall_entry, which points to one of the
+   routines below.  Both pop the return address into %edx, so
+   that the kernel finds the number at the stack pointer, and
+   return to it with the stack pointer where the call left it.
+
+   syscall_int uses "int $0x30", which works on any CPU.
+   syscall_sysenter uses the much faster SYSENTER instruction,
+   passing the stack pointer in %ecx and the return address in
+   %edx; the kernel returns to them with SYSEXIT.  On the first
+   system call, syscall_probe checks with CPUID whether the CPU
+   supports SYSENTER, as the kernel does before enabling it, and
+   picks one of them for all later calls.
+
+   %ecx and %edx are clobbered. */
+asm (".text\n"
+     "syscall_int:\n"
+     "        popl %edx\n"
+     "        int $0x30\n"
+     "        jmp *%edx\n"
+     "syscall_sysenter:\n"
+     "        popl %edx\n"
+     "        movl %esp, %ecx\n"
+     "        sysenter\n"
+     "syscall_probe:\n"
+     "        pushl %ebx\n"
+     "        movl $1, %eax\n"
+     "        cpuid\n"
+     "        popl %ebx\n"
+     "        movl $syscall_int, %eax\n"
+     "        testl $0x800, %edx\n"      /* CPUID.1:EDX.SEP */
+     "        jz 1f\n"
+     "        movl $syscall_sysenter, %eax\n"
+     "1:      movl %eax, syscall_entry\n"
+     "        jmp *%eax\n");
+
+void syscall_probe (void);
+
+/* Routine through which system calls enter the kernel. */
+void (*syscall_entry) (void) = syscall_probe;
+
 /* Invokes syscall NUMBER, passing no arguments, and returns the
    return value as an `int'. */
-#define syscall0(NUMBER)                                        \
-        ({                                                      \
-          int retval;                                           \
-          asm volatile                                          \
-            ("pushl %[number]; int $0x30; addl $4, %%esp"       \
-               : "=a" (retval)                                  \
-               : [number] "i" (NUMBER)                          \
-               : "memory");                                     \
-          retval;                                               \
+#define syscall0(NUMBER)                                                 \
+        ({                                                               \
+          int retval;                                                    \
+          asm volatile                                                   \
+            ("pushl %[number]; call *syscall_entry; addl $4, %%esp"      \
+               : "=a" (retval)                                           \
+               : [number] "i" (NUMBER)                                   \
+               : "ecx", "edx", "memory");                                \
+          retval;                                                        \
         })
 
 /* Invokes syscall NUMBER, passing argument ARG0, and returns the
@@ -22,45 +65,65 @@
         ({                                                               \
           int retval;                                                    \
           asm volatile                                                   \
-            ("pushl %[arg0]; pushl %[number]; int $0x30; addl $8, %%esp" \
+            ("pushl %[arg0]; pushl %[number]; "                          \
+             "call *syscall_entry; addl $8, %%esp"                       \
                : "=a" (retval)                                           \
                : [number] "i" (NUMBER),                                  \
                  [arg0] "g" (ARG0)                                       \
-               : "memory");                                              \
+               : "ecx", "edx", "memory");                                \
           retval;                                                        \
         })
 
 /* Invokes syscall NUMBER, passing arguments ARG0 and ARG1, and
    returns the return value as an `int'. */
-#define syscall2(NUMBER, ARG0, ARG1)                            \
-        ({                                                      \
-          int retval;                                           \
-          asm volatile                                          \
-            ("pushl %[arg1]; pushl %[arg0]; "                   \
-             "pushl %[number]; int $0x30; addl $12, %%esp"      \
-               : "=a" (retval)                                  \
-               : [number] "i" (NUMBER),                         \
-                 [arg0] "r" (ARG0),                             \
-                 [arg1] "r" (ARG1)                              \
-               : "memory");                                     \
-          retval;                                               \
+#define syscall2(NUMBER, ARG0, ARG1)                                     \
+        ({                                                               \
+          int retval;                                                    \
+          asm volatile                                                   \
+            ("pushl %[arg1]; pushl %[arg0]; "                            \
+             "pushl %[number]; call *syscall_entry; addl $12, %%esp"     \
+               : "=a" (retval)                                           \
+               : [number] "i" (NUMBER),                                  \
+                 [arg0] "r" (ARG0),                                      \
+                 [arg1] "r" (ARG1)                                       \
+               : "ecx", "edx", "memory");                                \
+          retval;                                                        \
         })
 
 /* Invokes syscall NUMBER, passing arguments ARG0, ARG1, and
    ARG2, and returns the return value as an `int'. */
-#define syscall3(NUMBER, ARG0, ARG1, ARG2)                      \
-        ({                                                      \
-          int retval;                                           \
-          asm volatile                                          \
-            ("pushl %[arg2]; pushl %[arg1]; pushl %[arg0]; "    \
-             "pushl %[number]; int $0x30; addl $16, %%esp"      \
-               : "=a" (retval)                                  \
-               : [number] "i" (NUMBER),                         \
-                 [arg0] "r" (ARG0),                             \
-                 [arg1] "r" (ARG1),                             \
-                 [arg2] "r" (ARG2)                              \
-               : "memory");                                     \
-          retval;                                               \
+#define syscall3(NUMBER, ARG0, ARG1, ARG2)                               \
+        ({                                                               \
+          int retval;                                                    \
+          asm volatile                                                   \
+            ("pushl %[arg2]; pushl %[arg1]; pushl %[arg0]; "             \
+             "pushl %[number]; call *syscall_entry; addl $16, %%esp"     \
+               : "=a" (retval)                                           \
+               : [number] "i" (NUMBER),                                  \
+                 [arg0] "r" (ARG0),                                      \
+                 [arg1] "r" (ARG1),                                      \
+                 [arg2] "r" (ARG2)                                       \
+               : "ecx", "edx", "memory");                                \
+          retval;                                                        \
+        })
+
+/* Invokes syscall NUMBER, passing arguments ARG0, ARG1, ARG2,
+   and ARG3, and returns the return value as an `int'. */
+#define syscall4(NUMBER, ARG0, ARG1, ARG2, ARG3)                         \
+        ({                                                               \
+          int retval;                                                    \
+          asm volatile                                                   \
+            ("pushl %[arg3]; pushl %[arg2]; pushl %[arg1]; "             \
+             "pushl %[arg0]; pushl %[number]; "                          \
+             "call *syscall_entry; addl $20, %%esp"                      \
+               : "=a" (retval)                                           \
+               : [number] "i" (NUMBER),                                  \
+                 [arg0] "r" (ARG0),                                      \
+                 [arg1] "r" (ARG1),                                      \
+                 [arg2] "r" (ARG2),                                      \
+                 [arg3] "g" (ARG3)                                       \
+               : "ecx", "edx", "memory");                                \
+          retval;                                                        \
         })
 
 int
@@ -89,6 +152,12 @@ exec (const char *file)
   return (pid_t) syscall1 (SYS_EXEC, file);
 }
 
+pid_t
+fork (void)
+{
+  return (pid_t) syscall0 (SYS_FORK);
+}
+
 int
 wait (pid_t pid)
 {
@@ -191,6 +260,78 @@ inumber (int fd)
   return syscall1 (SYS_INUMBER, fd);
 }
 
+int
+syscall_stats (int number, struct syscall_stats *stats)
+{
+  return syscall2 (SYS_SYSCALL_STATS, number, stats);
+}
+
+int
+pread (int fd, void *buffer, unsigned size, unsigned offset)
+{
+  return syscall4 (SYS_PREAD, fd, buffer, size, offset);
+}
+
+int
+pwrite (int fd, const void *buffer, unsigned size, unsigned offset)
+{
+  return syscall4 (SYS_PWRITE, fd, buffer, size, offset);
+}
+
+int
+readv (int fd, const struct iovec *iov, int iovcnt)
+{
+  return syscall3 (SYS_READV, fd, iov, iovcnt);
+}
+
+int
+writev (int fd, const struct iovec *iov, int iovcnt)
+{
+  return syscall3 (SYS_WRITEV, fd, iov, iovcnt);
+}
+
+int
+copy_file_range (int fd_in, int fd_out, unsigned length)
+{
+  return syscall3 (SYS_COPY_FILE_RANGE, fd_in, fd_out, length);
+}
+
+int
+pipe (int fds[2])
+{
+  return syscall1 (SYS_PIPE, fds);
+}
+
+int
+poll (struct pollfd *fds, unsigned nfds, int timeout)
+{
+  return syscall3 (SYS_POLL, fds, nfds, timeout);
+}
+
+shmid_t
+shm_create (unsigned size, int flags)
+{
+  return syscall2 (SYS_SHM_CREATE, size, flags);
+}
+
+void *
+shm_attach (shmid_t id, void *addr)
+{
+  return (void *) syscall2 (SYS_SHM_ATTACH, id, addr);
+}
+
+bool
+shm_detach (void *addr)
+{
+  return syscall1 (SYS_SHM_DETACH, addr);
+}
+
+int
+fsync (int fd)
+{
+  return syscall1 (SYS_FSYNC, fd);
+}
+
 void*
 sbrk (intptr_t increment)
 {
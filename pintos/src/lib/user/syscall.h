@@ -4,6 +4,9 @@
 #include <stdbool.h>
 #include <stdint.h>
 #include <debug.h>
+#include "../syscall-stats.h"
+#include "../poll.h"
+#include "../uio.h"
 
 /* Process identifier. */
 typedef int pid_t;
@@ -13,6 +16,13 @@ typedef int pid_t;
 typedef int mapid_t;
 #define MAP_FAILED ((mapid_t) -1)
 
+/* Shared-memory segment identifier. */
+typedef int shmid_t;
+#define SHM_FAILED ((shmid_t) -1)
+
+/* shm_create() flags. */
+#define SHM_HUGE 0x1            /* Physically contiguous backing. */
+
 /* Maximum characters in a filename written by readdir(). */
 #define READDIR_MAX_LEN 14
 
@@ -24,6 +34,7 @@ typedef int mapid_t;
 void halt (void) NO_RETURN;
 void exit (int status) NO_RETURN;
 pid_t exec (const char *file);
+pid_t fork (void);
 int wait (pid_t);
 bool create (const char *file, unsigned initial_size);
 bool remove (const char *file);
@@ -47,6 +58,20 @@ bool readdir (int fd, char name[READDIR_MAX_LEN + 1]);
 bool isdir (int fd);
 int inumber (int fd);
 
+/* Extensions. */
+int syscall_stats (int number, struct syscall_stats *);
+int pread (int fd, void *buffer, unsigned length, unsigned offset);
+int pwrite (int fd, const void *buffer, unsigned length, unsigned offset);
+int readv (int fd, const struct iovec *, int iovcnt);
+int writev (int fd, const struct iovec *, int iovcnt);
+int copy_file_range (int fd_in, int fd_out, unsigned length);
+int pipe (int fds[2]);
+int poll (struct pollfd *, unsigned nfds, int timeout);
+shmid_t shm_create (unsigned size, int flags);
+void *shm_attach (shmid_t, void *addr);
+bool shm_detach (void *addr);
+int fsync (int fd);
+
 /* Homework 5, Part B. */
 void* sbrk (intptr_t increment);
 
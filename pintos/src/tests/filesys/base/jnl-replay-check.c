@@ -0,0 +1,49 @@
+/* Run on the boot after jnl-replay, checks that replaying the
+   journal recovered the files it left, and that the file system
+   can still be modified afterward.  File contents are not
+   checked, because only metadata goes through the journal. */
+
+#include <stdio.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define FILE_CNT 30
+
+/* Checks that NAME exists and is SIZE bytes long. */
+static void
+check_size (const char *name, int size)
+{
+  int fd;
+
+  CHECK ((fd = open (name)) > 1, "open \"%s\"", name);
+  if (filesize (fd) != size)
+    fail ("\"%s\" is %d bytes long, not %d", name, filesize (fd), size);
+  close (fd);
+}
+
+void
+test_main (void)
+{
+  char name[16];
+  int i;
+
+  check_size ("large", 20000);
+  check_size ("grown", 5000);
+  CHECK (open ("gone") == -1, "open \"gone\" (must fail)");
+
+  msg ("checking %d files", FILE_CNT);
+  quiet = true;
+  for (i = 0; i < FILE_CNT; i++)
+    {
+      snprintf (name, sizeof name, "file%d", i);
+      if (i % 3 == 0)
+        CHECK (open (name) == -1, "open \"%s\" (must fail)", name);
+      else
+        check_size (name, i * 100);
+    }
+  quiet = false;
+
+  CHECK (create ("after", 3000), "create \"after\"");
+  CHECK (remove ("grown"), "remove \"grown\"");
+}
@@ -0,0 +1,19 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+our ($test);
+my (@output) = read_text_file ("$test.output");
+fail "Journal was not replayed at boot\n"
+  if !grep (/^Journal: replayed \d+ transactions$/, @output);
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(jnl-replay-check) begin
+(jnl-replay-check) open "large"
+(jnl-replay-check) open "grown"
+(jnl-replay-check) open "gone" (must fail)
+(jnl-replay-check) checking 30 files
+(jnl-replay-check) create "after"
+(jnl-replay-check) remove "grown"
+(jnl-replay-check) end
+EOF
+pass;
@@ -0,0 +1,45 @@
+/* Creates, grows, and removes files, enough of them to make the
+   root directory convert itself to a hash table, and then has the
+   kernel power off without writing the file system back.  The
+   next boot must replay the journal to recover them, which
+   jnl-replay-check verifies. */
+
+#include <stdio.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define FILE_CNT 30
+
+static char buf[5000];
+
+void
+test_main (void)
+{
+  char name[16];
+  int fd;
+  int i;
+
+  CHECK (create ("large", 20000), "create \"large\"");
+  CHECK (create ("grown", 0), "create \"grown\"");
+  CHECK ((fd = open ("grown")) > 1, "open \"grown\"");
+  CHECK (write (fd, buf, sizeof buf) == sizeof buf, "write \"grown\"");
+  msg ("close \"grown\"");
+  close (fd);
+  CHECK (create ("gone", 1234), "create \"gone\"");
+  CHECK (remove ("gone"), "remove \"gone\"");
+
+  msg ("creating %d files", FILE_CNT);
+  quiet = true;
+  for (i = 0; i < FILE_CNT; i++)
+    {
+      snprintf (name, sizeof name, "file%d", i);
+      CHECK (create (name, i * 100), "create \"%s\"", name);
+    }
+  for (i = 0; i < FILE_CNT; i += 3)
+    {
+      snprintf (name, sizeof name, "file%d", i);
+      CHECK (remove (name), "remove \"%s\"", name);
+    }
+  quiet = false;
+}
@@ -0,0 +1,17 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(jnl-replay) begin
+(jnl-replay) create "large"
+(jnl-replay) create "grown"
+(jnl-replay) open "grown"
+(jnl-replay) write "grown"
+(jnl-replay) close "grown"
+(jnl-replay) create "gone"
+(jnl-replay) remove "gone"
+(jnl-replay) creating 30 files
+(jnl-replay) end
+EOF
+pass;
@@ -0,0 +1,67 @@
+/* Copies sample.txt into new files with copy_file_range(),
+   checking the contents, the file positions, a short copy at end
+   of file, a destination that has to grow, and the arguments
+   that must be refused. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/userprog/sample.inc"
+#include "tests/lib.h"
+#include "tests/main.h"
+
+/* Where the second copy starts in "grow.txt", which is created
+   shorter than the copy. */
+#define GROW_OFS 5
+
+void
+test_main (void)
+{
+  char buf[GROW_OFS + sizeof sample];
+  size_t size = sizeof sample - 1;
+  int in, out, again;
+
+  CHECK ((in = open ("sample.txt")) > 1, "open \"sample.txt\"");
+  CHECK (create ("test.txt", 0), "create \"test.txt\"");
+  CHECK ((out = open ("test.txt")) > 1, "open \"test.txt\"");
+  CHECK (copy_file_range (in, out, size) == (int) size,
+         "copy_file_range \"sample.txt\" to \"test.txt\"");
+  CHECK (tell (in) == size && tell (out) == size,
+         "both positions advanced by %zu", size);
+  check_file ("test.txt", sample, size);
+
+  /* Short copies. */
+  CHECK (copy_file_range (in, out, 10) == 0,
+         "copy_file_range at end of file returns 0");
+  seek (in, size - 4);
+  CHECK (copy_file_range (in, out, 10) == 4,
+         "copy_file_range across end of file returns 4");
+  CHECK (filesize (out) == (int) size + 4, "\"test.txt\" is %zu bytes",
+         size + 4);
+
+  /* Refused arguments. */
+  seek (in, 0);
+  CHECK (copy_file_range (in, out, -1) == -1,
+         "copy_file_range of negative length returns -1");
+  CHECK (copy_file_range (out, out, 10) == -1,
+         "copy_file_range from a file to itself returns -1");
+  CHECK ((again = open ("test.txt")) > 1, "open \"test.txt\" again");
+  CHECK (copy_file_range (again, out, 10) == -1,
+         "copy_file_range to the same file returns -1");
+  CHECK (copy_file_range (0x20101234, out, 10) == -1,
+         "copy_file_range from bad fd returns -1");
+  CHECK (tell (in) == 0, "position unmoved by refused copies");
+
+  /* A destination shorter than the copy grows to fit. */
+  CHECK (create ("grow.txt", GROW_OFS + 1), "create \"grow.txt\"");
+  CHECK ((out = open ("grow.txt")) > 1, "open \"grow.txt\"");
+  seek (out, GROW_OFS);
+  CHECK (copy_file_range (in, out, size) == (int) size,
+         "copy_file_range \"sample.txt\" to \"grow.txt\"");
+  CHECK (filesize (out) == GROW_OFS + (int) size,
+         "\"grow.txt\" grew to %zu bytes", GROW_OFS + size);
+  memset (buf, 'x', sizeof buf);
+  CHECK (pread (out, buf, GROW_OFS + size, 0) == GROW_OFS + (int) size,
+         "pread \"grow.txt\"");
+  compare_bytes (buf, "\0\0\0\0\0", GROW_OFS, 0, "grow.txt");
+  compare_bytes (buf + GROW_OFS, sample, size, GROW_OFS, "grow.txt");
+}
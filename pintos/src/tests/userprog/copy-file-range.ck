@@ -0,0 +1,30 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(copy-file-range) begin
+(copy-file-range) open "sample.txt"
+(copy-file-range) create "test.txt"
+(copy-file-range) open "test.txt"
+(copy-file-range) copy_file_range "sample.txt" to "test.txt"
+(copy-file-range) both positions advanced by 239
+(copy-file-range) verified contents of "test.txt"
+(copy-file-range) copy_file_range at end of file returns 0
+(copy-file-range) copy_file_range across end of file returns 4
+(copy-file-range) "test.txt" is 243 bytes
+(copy-file-range) copy_file_range of negative length returns -1
+(copy-file-range) copy_file_range from a file to itself returns -1
+(copy-file-range) open "test.txt" again
+(copy-file-range) copy_file_range to the same file returns -1
+(copy-file-range) copy_file_range from bad fd returns -1
+(copy-file-range) position unmoved by refused copies
+(copy-file-range) create "grow.txt"
+(copy-file-range) open "grow.txt"
+(copy-file-range) copy_file_range "sample.txt" to "grow.txt"
+(copy-file-range) "grow.txt" grew to 244 bytes
+(copy-file-range) pread "grow.txt"
+(copy-file-range) end
+copy-file-range: exit(0)
+EOF
+pass;
@@ -0,0 +1,37 @@
+/* Opens sample.txt over and over, until the descriptor table,
+   which starts with 32 descriptors and grows, is full.  Checks
+   that each open() returns the lowest free descriptor, including
+   one freed in the middle of the grown table, and that open()
+   fails once all FD_MAX descriptors are in use. */
+
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+/* Descriptors per process, as in userprog/fdtable.h. */
+#define FD_MAX 4096
+
+void
+test_main (void)
+{
+  int fd;
+
+  msg ("open \"sample.txt\" until it fails");
+  for (fd = 2; fd < FD_MAX; fd++)
+    {
+      int handle = open ("sample.txt");
+      if (handle != fd)
+        fail ("open() returned %d, not %d", handle, fd);
+    }
+  CHECK (open ("sample.txt") == -1, "open with %d descriptors open fails",
+         FD_MAX);
+  CHECK (filesize (FD_MAX - 1) == 239, "descriptor %d refers to sample.txt",
+         FD_MAX - 1);
+
+  msg ("close descriptors 10 and 40");
+  close (40);
+  close (10);
+  CHECK (open ("sample.txt") == 10, "open returns 10");
+  CHECK (open ("sample.txt") == 40, "open returns 40");
+  CHECK (open ("sample.txt") == -1, "open fails again");
+}
@@ -0,0 +1,17 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(open-many) begin
+(open-many) open "sample.txt" until it fails
+(open-many) open with 4096 descriptors open fails
+(open-many) descriptor 4095 refers to sample.txt
+(open-many) close descriptors 10 and 40
+(open-many) open returns 10
+(open-many) open returns 40
+(open-many) open fails again
+(open-many) end
+open-many: exit(0)
+EOF
+pass;
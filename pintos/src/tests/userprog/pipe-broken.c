@@ -0,0 +1,20 @@
+/* Closes the only read end of a pipe and checks that writing to
+   it then fails, without blocking or killing the process. */
+
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+void
+test_main (void)
+{
+  int fds[2];
+
+  CHECK (pipe (fds) == 0, "pipe");
+  close (fds[0]);
+  msg ("close read end");
+
+  CHECK (write (fds[1], "hello", 5) == -1, "write returns -1");
+  CHECK (write (fds[1], "hello", 5) == -1, "write returns -1");
+  close (fds[1]);
+}
@@ -0,0 +1,14 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(pipe-broken) begin
+(pipe-broken) pipe
+(pipe-broken) close read end
+(pipe-broken) write returns -1
+(pipe-broken) write returns -1
+(pipe-broken) end
+pipe-broken: exit(0)
+EOF
+pass;
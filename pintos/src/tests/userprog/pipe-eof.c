@@ -0,0 +1,24 @@
+/* Closes the only write end of a pipe that still holds data and
+   checks that a reader gets the data and then end of file. */
+
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+void
+test_main (void)
+{
+  char buf[16];
+  int fds[2];
+
+  CHECK (pipe (fds) == 0, "pipe");
+  CHECK (write (fds[1], "hello", 5) == 5, "write 5 bytes");
+  close (fds[1]);
+  msg ("close write end");
+
+  CHECK (read (fds[0], buf, sizeof buf) == 5, "read returns 5 bytes");
+  compare_bytes (buf, "hello", 5, 0, "pipe");
+  CHECK (read (fds[0], buf, sizeof buf) == 0, "read returns end of file");
+  CHECK (read (fds[0], buf, sizeof buf) == 0, "read returns end of file");
+  close (fds[0]);
+}
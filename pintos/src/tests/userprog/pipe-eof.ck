@@ -0,0 +1,16 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(pipe-eof) begin
+(pipe-eof) pipe
+(pipe-eof) write 5 bytes
+(pipe-eof) close write end
+(pipe-eof) read returns 5 bytes
+(pipe-eof) read returns end of file
+(pipe-eof) read returns end of file
+(pipe-eof) end
+pipe-eof: exit(0)
+EOF
+pass;
@@ -0,0 +1,47 @@
+/* Creates a pipe and passes data through it within one process,
+   more than once around its ring buffer, checking that reads
+   return what was written, in order. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define CHUNK 10000
+#define ROUNDS 5
+
+static char wbuf[CHUNK];
+static char rbuf[CHUNK];
+
+void
+test_main (void)
+{
+  int fds[2];
+  int round;
+
+  CHECK (pipe (fds) == 0, "pipe");
+  CHECK (fds[0] > 1 && fds[1] > 1 && fds[0] != fds[1],
+         "pipe returned two new descriptors");
+
+  msg ("write and read %d rounds", ROUNDS);
+  for (round = 0; round < ROUNDS; round++)
+    {
+      size_t i;
+      int n;
+
+      for (i = 0; i < CHUNK; i++)
+        wbuf[i] = i * 7 + round;
+      n = write (fds[1], wbuf, CHUNK);
+      if (n != CHUNK)
+        fail ("write returned %d in round %d", n, round);
+      n = read (fds[0], rbuf, CHUNK);
+      if (n != CHUNK)
+        fail ("read returned %d in round %d", n, round);
+      compare_bytes (rbuf, wbuf, CHUNK, 0, "pipe");
+    }
+
+  CHECK (read (fds[1], rbuf, 1) == -1, "read from write end fails");
+  CHECK (write (fds[0], wbuf, 1) == -1, "write to read end fails");
+  close (fds[0]);
+  close (fds[1]);
+}
@@ -0,0 +1,15 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(pipe-normal) begin
+(pipe-normal) pipe
+(pipe-normal) pipe returned two new descriptors
+(pipe-normal) write and read 5 rounds
+(pipe-normal) read from write end fails
+(pipe-normal) write to read end fails
+(pipe-normal) end
+pipe-normal: exit(0)
+EOF
+pass;
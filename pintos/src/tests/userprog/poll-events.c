@@ -0,0 +1,45 @@
+/* Checks the events poll() reports for the ends of a pipe as it
+   fills and closes, for a file, and for bad and negative
+   descriptors. */
+
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+void
+test_main (void)
+{
+  struct pollfd pfds[4];
+  char buf[16];
+  int fds[2];
+
+  CHECK (pipe (fds) == 0, "pipe");
+  pfds[0].fd = fds[0];
+  pfds[0].events = POLLIN;
+  pfds[1].fd = fds[1];
+  pfds[1].events = POLLOUT;
+  pfds[2].fd = 0x20101234;
+  pfds[2].events = POLLIN;
+  pfds[3].fd = -1;
+  pfds[3].events = POLLIN;
+
+  CHECK (poll (pfds, 4, -1) == 2, "poll returns 2");
+  CHECK (pfds[0].revents == 0, "read end not readable");
+  CHECK (pfds[1].revents == POLLOUT, "write end writable");
+  CHECK (pfds[2].revents == POLLNVAL, "bad fd invalid");
+  CHECK (pfds[3].revents == 0, "negative fd ignored");
+
+  CHECK (write (fds[1], "x", 1) == 1, "write 1 byte");
+  CHECK (poll (pfds, 2, -1) == 2, "poll returns 2");
+  CHECK (pfds[0].revents == POLLIN, "read end readable");
+
+  close (fds[1]);
+  msg ("close write end");
+  CHECK (poll (pfds, 1, -1) == 1, "poll returns 1");
+  CHECK (pfds[0].revents == (POLLIN | POLLHUP),
+         "read end readable and hung up");
+  CHECK (read (fds[0], buf, sizeof buf) == 1, "read 1 byte");
+  CHECK (poll (pfds, 1, -1) == 1, "poll returns 1");
+  CHECK (pfds[0].revents == POLLHUP, "read end hung up");
+  close (fds[0]);
+}
@@ -0,0 +1,25 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(poll-events) begin
+(poll-events) pipe
+(poll-events) poll returns 2
+(poll-events) read end not readable
+(poll-events) write end writable
+(poll-events) bad fd invalid
+(poll-events) negative fd ignored
+(poll-events) write 1 byte
+(poll-events) poll returns 2
+(poll-events) read end readable
+(poll-events) close write end
+(poll-events) poll returns 1
+(poll-events) read end readable and hung up
+(poll-events) read 1 byte
+(poll-events) poll returns 1
+(poll-events) read end hung up
+(poll-events) end
+poll-events: exit(0)
+EOF
+pass;
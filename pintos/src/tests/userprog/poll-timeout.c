@@ -0,0 +1,30 @@
+/* Polls an empty pipe for input with a timeout of 0, which must
+   not wait, and of 100 ms, which must return once it expires,
+   and checks that both report no descriptors ready. */
+
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+void
+test_main (void)
+{
+  struct pollfd pfd;
+  int fds[2];
+
+  CHECK (pipe (fds) == 0, "pipe");
+  pfd.fd = fds[0];
+  pfd.events = POLLIN;
+
+  pfd.revents = -1;
+  CHECK (poll (&pfd, 1, 0) == 0, "poll with timeout 0 returns 0");
+  CHECK (pfd.revents == 0, "no events pending");
+
+  pfd.revents = -1;
+  CHECK (poll (&pfd, 1, 100) == 0, "poll with timeout 100 returns 0");
+  CHECK (pfd.revents == 0, "no events pending");
+
+  CHECK (poll (NULL, 0, 100) == 0, "poll of no descriptors returns 0");
+  close (fds[0]);
+  close (fds[1]);
+}
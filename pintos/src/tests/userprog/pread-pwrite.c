@@ -0,0 +1,53 @@
+/* Writes sample.txt into a new file with pwrite(), back to
+   front, and reads it back with pread(), checking that neither
+   moves the file position. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/userprog/sample.inc"
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define CHUNK 37
+
+void
+test_main (void)
+{
+  char buf[sizeof sample];
+  size_t size = sizeof sample - 1;
+  int handle;
+  int ofs;
+
+  CHECK (create ("test.txt", 0), "create \"test.txt\"");
+  CHECK ((handle = open ("test.txt")) > 1, "open \"test.txt\"");
+
+  /* Back to front, so that each pwrite() but the first writes
+     before end of file and the first grows the file. */
+  msg ("pwrite \"test.txt\"");
+  for (ofs = (size - 1) / CHUNK * CHUNK; ofs >= 0; ofs -= CHUNK)
+    {
+      int n = size - ofs < CHUNK ? (int) (size - ofs) : CHUNK;
+      if (pwrite (handle, sample + ofs, n, ofs) != n)
+        fail ("pwrite of %d bytes at offset %d failed", n, ofs);
+    }
+  CHECK (tell (handle) == 0, "position unmoved by pwrite");
+  CHECK (filesize (handle) == (int) size, "file is %zu bytes", size);
+
+  msg ("pread \"test.txt\"");
+  memset (buf, 0, sizeof buf);
+  for (ofs = 0; (size_t) ofs < size; ofs += CHUNK)
+    {
+      int n = size - ofs < CHUNK ? (int) (size - ofs) : CHUNK;
+      if (pread (handle, buf + ofs, n, ofs) != n)
+        fail ("pread of %d bytes at offset %d failed", n, ofs);
+    }
+  compare_bytes (buf, sample, size, 0, "test.txt");
+  CHECK (tell (handle) == 0, "position unmoved by pread");
+
+  CHECK (pread (handle, buf, sizeof buf, size) == 0,
+         "pread at end of file returns 0");
+  CHECK (pread (handle, buf, 10, size - 4) == 4,
+         "pread across end of file returns 4");
+  CHECK (pread (0x20101234, buf, 10, 0) == -1,
+         "pread of bad fd returns -1");
+}
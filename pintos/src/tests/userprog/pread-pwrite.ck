@@ -0,0 +1,20 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(pread-pwrite) begin
+(pread-pwrite) create "test.txt"
+(pread-pwrite) open "test.txt"
+(pread-pwrite) pwrite "test.txt"
+(pread-pwrite) position unmoved by pwrite
+(pread-pwrite) file is 239 bytes
+(pread-pwrite) pread "test.txt"
+(pread-pwrite) position unmoved by pread
+(pread-pwrite) pread at end of file returns 0
+(pread-pwrite) pread across end of file returns 4
+(pread-pwrite) pread of bad fd returns -1
+(pread-pwrite) end
+pread-pwrite: exit(0)
+EOF
+pass;
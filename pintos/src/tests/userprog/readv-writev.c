@@ -0,0 +1,52 @@
+/* Writes sample.txt into a new file with one writev() of three
+   buffers and reads it back with one readv() into three buffers
+   of other sizes, then checks short and invalid vectors. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/userprog/sample.inc"
+#include "tests/lib.h"
+#include "tests/main.h"
+
+void
+test_main (void)
+{
+  size_t size = sizeof sample - 1;
+  char a[100], b[1], c[sizeof sample];
+  struct iovec iov[3];
+  int handle;
+
+  CHECK (create ("test.txt", 0), "create \"test.txt\"");
+  CHECK ((handle = open ("test.txt")) > 1, "open \"test.txt\"");
+
+  iov[0].iov_base = sample;
+  iov[0].iov_len = 10;
+  iov[1].iov_base = sample + 10;
+  iov[1].iov_len = 0;
+  iov[2].iov_base = sample + 10;
+  iov[2].iov_len = size - 10;
+  CHECK (writev (handle, iov, 3) == (int) size, "writev %zu bytes", size);
+  CHECK (tell (handle) == (unsigned) size, "position advanced by writev");
+
+  seek (handle, 0);
+  memset (c, 0, sizeof c);
+  iov[0].iov_base = a;
+  iov[0].iov_len = sizeof a;
+  iov[1].iov_base = b;
+  iov[1].iov_len = sizeof b;
+  iov[2].iov_base = c;
+  iov[2].iov_len = sizeof c;
+  CHECK (readv (handle, iov, 3) == (int) size,
+         "readv stops at end of file");
+  compare_bytes (a, sample, sizeof a, 0, "test.txt");
+  compare_bytes (b, sample + sizeof a, sizeof b, sizeof a, "test.txt");
+  compare_bytes (c, sample + sizeof a + sizeof b,
+                 size - sizeof a - sizeof b, sizeof a + sizeof b,
+                 "test.txt");
+  CHECK (readv (handle, iov, 3) == 0, "readv at end of file returns 0");
+
+  CHECK (readv (handle, iov, 0) == 0, "readv of no buffers returns 0");
+  CHECK (readv (handle, iov, IOV_MAX + 1) == -1,
+         "readv of more than IOV_MAX buffers returns -1");
+  CHECK (writev (0x20101234, iov, 1) == -1, "writev of bad fd returns -1");
+}
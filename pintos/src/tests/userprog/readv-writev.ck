@@ -0,0 +1,19 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(readv-writev) begin
+(readv-writev) create "test.txt"
+(readv-writev) open "test.txt"
+(readv-writev) writev 239 bytes
+(readv-writev) position advanced by writev
+(readv-writev) readv stops at end of file
+(readv-writev) readv at end of file returns 0
+(readv-writev) readv of no buffers returns 0
+(readv-writev) readv of more than IOV_MAX buffers returns -1
+(readv-writev) writev of bad fd returns -1
+(readv-writev) end
+readv-writev: exit(0)
+EOF
+pass;
@@ -0,0 +1,63 @@
+/* Forks a child that writes to data, BSS and stack pages it
+   shares copy-on-write with its parent, and verifies that the
+   parent's copies of those pages keep their contents. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define SIZE (4 * 4096)
+
+static char data[4096] = "parent";
+static char bss[SIZE];
+
+/* Fails unless each of the SIZE bytes in BUF is C. */
+static void
+check_all (const char *buf, size_t size, char c, const char *what)
+{
+  size_t i;
+
+  for (i = 0; i < size; i++)
+    if (buf[i] != c)
+      fail ("%s byte %zu is %d, not %d", what, i, buf[i], c);
+}
+
+void
+test_main (void)
+{
+  char stack[4096];
+  pid_t child;
+  int status;
+
+  memset (bss, 'p', sizeof bss);
+  memset (stack, 'p', sizeof stack);
+
+  CHECK ((child = fork ()) != PID_ERROR, "fork");
+  if (child == 0)
+    {
+      /* The child starts out with the parent's data... */
+      if (strcmp (data, "parent"))
+        fail ("child sees \"%s\" in data", data);
+      check_all (bss, sizeof bss, 'p', "child's bss");
+      check_all (stack, sizeof stack, 'p', "child's stack");
+
+      /* ...and its writes are its own. */
+      strlcpy (data, "child", sizeof data);
+      memset (bss, 'c', sizeof bss);
+      memset (stack, 'c', sizeof stack);
+      if (strcmp (data, "child"))
+        fail ("child's write to data lost");
+      check_all (bss, sizeof bss, 'c', "child's bss");
+      check_all (stack, sizeof stack, 'c', "child's stack");
+      exit (81);
+    }
+
+  status = wait (child);
+  CHECK (status == 81, "wait for child (must return 81)");
+
+  CHECK (!strcmp (data, "parent"), "parent's data unchanged");
+  check_all (bss, sizeof bss, 'p', "parent's bss");
+  check_all (stack, sizeof stack, 'p', "parent's stack");
+  msg ("parent's bss and stack unchanged");
+}
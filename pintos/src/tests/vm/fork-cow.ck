@@ -0,0 +1,15 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(fork-cow) begin
+(fork-cow) fork
+fork-cow: exit(81)
+(fork-cow) wait for child (must return 81)
+(fork-cow) parent's data unchanged
+(fork-cow) parent's bss and stack unchanged
+(fork-cow) end
+fork-cow: exit(0)
+EOF
+pass;
@@ -0,0 +1,41 @@
+/* Grows the descriptor table past its initial 32 descriptors,
+   frees one in the middle, and forks.  The child must get a copy
+   of the whole grown table, hand out the same lowest free
+   descriptor as the parent, and close descriptors without
+   affecting the parent's. */
+
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+/* Descriptors opened, 2 through LAST_FD. */
+#define LAST_FD 41
+
+void
+test_main (void)
+{
+  pid_t child;
+  int fd;
+
+  msg ("open \"sample.txt\" %d times", LAST_FD - 1);
+  for (fd = 2; fd <= LAST_FD; fd++)
+    if (open ("sample.txt") != fd)
+      fail ("open() did not return %d", fd);
+  msg ("close descriptor 20");
+  close (20);
+
+  CHECK ((child = fork ()) != PID_ERROR, "fork");
+  if (child == 0)
+    {
+      CHECK (filesize (LAST_FD) > 0, "child: descriptor %d is open",
+             LAST_FD);
+      CHECK (open ("sample.txt") == 20, "child: open returns 20");
+      msg ("child: close descriptor %d", LAST_FD);
+      close (LAST_FD);
+      exit (0);
+    }
+
+  CHECK (wait (child) == 0, "wait for child (must return 0)");
+  CHECK (filesize (LAST_FD) > 0, "descriptor %d is still open", LAST_FD);
+  CHECK (open ("sample.txt") == 20, "open returns 20");
+}
@@ -0,0 +1,20 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(fork-fds) begin
+(fork-fds) open "sample.txt" 40 times
+(fork-fds) close descriptor 20
+(fork-fds) fork
+(fork-fds) child: descriptor 41 is open
+(fork-fds) child: open returns 20
+(fork-fds) child: close descriptor 41
+fork-fds: exit(0)
+(fork-fds) wait for child (must return 0)
+(fork-fds) descriptor 41 is still open
+(fork-fds) open returns 20
+(fork-fds) end
+fork-fds: exit(0)
+EOF
+pass;
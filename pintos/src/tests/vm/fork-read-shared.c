@@ -0,0 +1,51 @@
+/* Forks a child that shares an open file, and its position,
+   with its parent.  Both then read the file a byte at a time,
+   concurrently, until end of file.  Each read must return 0 or
+   1 byte, however the other process moves the position, and
+   the shared position must end up at end of file. */
+
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define SIZE 8192
+
+static char buf[SIZE];
+
+/* Reads FD a byte at a time until end of file. */
+static void
+read_bytes (int fd)
+{
+  for (;;)
+    {
+      char c;
+      int n = read (fd, &c, 1);
+
+      if (n == 0)
+        return;
+      if (n != 1)
+        fail ("read returned %d", n);
+    }
+}
+
+void
+test_main (void)
+{
+  pid_t child;
+  int fd, status;
+
+  CHECK (create ("data", SIZE), "create \"data\"");
+  CHECK ((fd = open ("data")) > 1, "open \"data\"");
+  CHECK (write (fd, buf, SIZE) == SIZE, "write \"data\"");
+  seek (fd, 0);
+
+  CHECK ((child = fork ()) != PID_ERROR, "fork");
+  read_bytes (fd);
+  if (child == 0)
+    exit (0);
+
+  status = wait (child);
+  CHECK (status == 0, "wait for child (must return 0)");
+  CHECK (tell (fd) == SIZE, "shared position at end of file");
+  close (fd);
+}
@@ -0,0 +1,17 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(fork-read-shared) begin
+(fork-read-shared) create "data"
+(fork-read-shared) open "data"
+(fork-read-shared) write "data"
+(fork-read-shared) fork
+fork-read-shared: exit(0)
+(fork-read-shared) wait for child (must return 0)
+(fork-read-shared) shared position at end of file
+(fork-read-shared) end
+fork-read-shared: exit(0)
+EOF
+pass;
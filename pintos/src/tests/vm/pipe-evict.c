@@ -0,0 +1,55 @@
+/* Has a parent wait on an empty pipe with a fresh, never touched
+   BSS buffer, so that its forked child's write is copied straight
+   into that buffer, then forces the buffer out of memory by
+   touching 2 MB of other memory, and checks that the data read
+   from the pipe survived the trip to swap and back. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/arc4.h"
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define SIZE (3 * 4096)
+#define BIG (2 * 1024 * 1024)
+
+static char data[SIZE];
+static char fresh[SIZE];
+static char big[BIG];
+
+void
+test_main (void)
+{
+  struct arc4 arc4;
+  int fds[2];
+  pid_t child;
+  int status;
+  int n;
+
+  arc4_init (&arc4, "pipe-evict", 10);
+  arc4_crypt (&arc4, data, SIZE);
+
+  CHECK (pipe (fds) == 0, "pipe");
+  CHECK ((child = fork ()) != PID_ERROR, "fork");
+  if (child == 0)
+    {
+      /* Give the parent time to block in read(), so that the data
+         goes straight into its buffer rather than the ring. */
+      memset (big, 1, BIG / 8);
+      if (write (fds[1], data, SIZE) != SIZE)
+        fail ("child's write failed");
+      exit (0);
+    }
+
+  n = read (fds[0], fresh, SIZE);
+  status = wait (child);
+  CHECK (status == 0, "wait for child (must return 0)");
+  CHECK (n == SIZE, "read %d bytes from pipe", SIZE);
+
+  msg ("touch 2 MB of memory");
+  memset (big, 0x5a, BIG);
+
+  CHECK (!memcmp (fresh, data, SIZE), "data read from pipe intact");
+  close (fds[0]);
+  close (fds[1]);
+}
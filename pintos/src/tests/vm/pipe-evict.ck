@@ -0,0 +1,17 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(pipe-evict) begin
+(pipe-evict) pipe
+(pipe-evict) fork
+pipe-evict: exit(0)
+(pipe-evict) wait for child (must return 0)
+(pipe-evict) read 12288 bytes from pipe
+(pipe-evict) touch 2 MB of memory
+(pipe-evict) data read from pipe intact
+(pipe-evict) end
+pipe-evict: exit(0)
+EOF
+pass;
@@ -0,0 +1,60 @@
+/* Forks a child that writes several ring buffers' worth of data
+   into a pipe, so that it blocks while the pipe is full, and has
+   the parent read it back in pieces of assorted sizes, blocking
+   while the pipe is empty.  Checks the data, and that the parent
+   sees end of file once the child has exited. */
+
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define SIZE (64 * 1024)
+
+static char buf[SIZE];
+
+void
+test_main (void)
+{
+  int fds[2];
+  size_t i, ofs;
+  pid_t child;
+  int status;
+
+  for (i = 0; i < SIZE; i++)
+    buf[i] = i * 13 + i / 256;
+
+  CHECK (pipe (fds) == 0, "pipe");
+  CHECK ((child = fork ()) != PID_ERROR, "fork");
+  if (child == 0)
+    {
+      close (fds[0]);
+      for (ofs = 0; ofs < SIZE; ofs += 5000)
+        {
+          int n = SIZE - ofs < 5000 ? (int) (SIZE - ofs) : 5000;
+          if (write (fds[1], buf + ofs, n) != n)
+            fail ("child's write of %d bytes at %zu failed", n, ofs);
+        }
+      exit (0);
+    }
+
+  /* Read into a buffer that starts out wrong. */
+  close (fds[1]);
+  for (i = 0; i < SIZE; i++)
+    buf[i] = 0;
+  for (ofs = 0; ofs < SIZE; )
+    {
+      size_t want = (ofs % 7 + 1) * 1000;
+      int n = read (fds[0], buf + ofs, want < SIZE - ofs ? want : SIZE - ofs);
+      if (n <= 0)
+        fail ("read at %zu returned %d", ofs, n);
+      ofs += n;
+    }
+  for (i = 0; i < SIZE; i++)
+    if (buf[i] != (char) (i * 13 + i / 256))
+      fail ("byte %zu read from pipe is wrong", i);
+
+  status = wait (child);
+  CHECK (status == 0, "wait for child (must return 0)");
+  CHECK (read (fds[0], buf, 1) == 0, "read returns end of file");
+  close (fds[0]);
+}
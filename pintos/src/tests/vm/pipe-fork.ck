@@ -0,0 +1,15 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(pipe-fork) begin
+(pipe-fork) pipe
+(pipe-fork) fork
+pipe-fork: exit(0)
+(pipe-fork) wait for child (must return 0)
+(pipe-fork) read returns end of file
+(pipe-fork) end
+pipe-fork: exit(0)
+EOF
+pass;
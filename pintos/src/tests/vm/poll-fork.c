@@ -0,0 +1,37 @@
+/* Has a parent poll an empty pipe with no timeout while its
+   forked child writes to it, and checks that the write wakes the
+   parent up with the pipe readable. */
+
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+void
+test_main (void)
+{
+  struct pollfd pfd;
+  char c;
+  int fds[2];
+  pid_t child;
+  int ready, status;
+
+  CHECK (pipe (fds) == 0, "pipe");
+  CHECK ((child = fork ()) != PID_ERROR, "fork");
+  if (child == 0)
+    {
+      if (write (fds[1], "x", 1) != 1)
+        fail ("child's write failed");
+      exit (0);
+    }
+
+  close (fds[1]);
+  pfd.fd = fds[0];
+  pfd.events = POLLIN;
+  ready = poll (&pfd, 1, -1);
+  status = wait (child);
+  CHECK (status == 0, "wait for child (must return 0)");
+  CHECK (ready == 1, "poll returned 1");
+  CHECK (pfd.revents & POLLIN, "pipe readable");
+  CHECK (read (fds[0], &c, 1) == 1 && c == 'x', "read child's byte");
+  close (fds[0]);
+}
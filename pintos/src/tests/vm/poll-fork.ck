@@ -0,0 +1,17 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(poll-fork) begin
+(poll-fork) pipe
+(poll-fork) fork
+poll-fork: exit(0)
+(poll-fork) wait for child (must return 0)
+(poll-fork) poll returned 1
+(poll-fork) pipe readable
+(poll-fork) read child's byte
+(poll-fork) end
+poll-fork: exit(0)
+EOF
+pass;
@@ -0,0 +1,31 @@
+/* Creates one-page shared-memory segments without attaching them
+   until shm_create() fails, which it must do well before running
+   out of memory, then checks that attaching and detaching one of
+   them makes room for another. */
+
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define MAX_TRIES 64
+
+void
+test_main (void)
+{
+  char *shared = (char *) 0x10000000;
+  shmid_t ids[MAX_TRIES];
+  int cnt;
+
+  for (cnt = 0; cnt < MAX_TRIES; cnt++)
+    if ((ids[cnt] = shm_create (4096, 0)) == SHM_FAILED)
+      break;
+  CHECK (cnt > 0 && cnt < MAX_TRIES,
+         "shm_create fails once too many segments are held");
+
+  CHECK (shm_attach (ids[0], shared) == shared, "shm_attach");
+  CHECK (shm_create (4096, 0) == SHM_FAILED,
+         "attaching held segment does not make room");
+  CHECK (shm_detach (shared), "shm_detach");
+  CHECK (shm_create (4096, 0) != SHM_FAILED,
+         "detaching makes room for another segment");
+}
@@ -0,0 +1,15 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(shm-limit) begin
+(shm-limit) shm_create fails once too many segments are held
+(shm-limit) shm_attach
+(shm-limit) attaching held segment does not make room
+(shm-limit) shm_detach
+(shm-limit) detaching makes room for another segment
+(shm-limit) end
+shm-limit: exit(0)
+EOF
+pass;
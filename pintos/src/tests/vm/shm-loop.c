@@ -0,0 +1,37 @@
+/* Creates, attaches, fills and detaches a 1 MB shared-memory
+   segment over and over, many more times than memory could hold
+   such segments at once, which works only if detaching frees each
+   one. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define SIZE (1024 * 1024)
+#define ROUNDS 64
+
+void
+test_main (void)
+{
+  char *shared = (char *) 0x10000000;
+  int i;
+
+  msg ("create, attach and detach %d segments", ROUNDS);
+  for (i = 0; i < ROUNDS; i++)
+    {
+      shmid_t id = shm_create (SIZE, 0);
+
+      if (id == SHM_FAILED)
+        fail ("shm_create failed in round %d", i);
+      if (shm_attach (id, shared) != shared)
+        fail ("shm_attach failed in round %d", i);
+      if (shared[0] != 0 || shared[SIZE - 1] != 0)
+        fail ("new segment not zeroed in round %d", i);
+      memset (shared, i, SIZE);
+      if (!shm_detach (shared))
+        fail ("shm_detach failed in round %d", i);
+      if (shm_attach (id, shared) != NULL)
+        fail ("segment outlived its last detach in round %d", i);
+    }
+}
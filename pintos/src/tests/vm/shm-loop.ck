@@ -0,0 +1,11 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(shm-loop) begin
+(shm-loop) create, attach and detach 64 segments
+(shm-loop) end
+shm-loop: exit(0)
+EOF
+pass;
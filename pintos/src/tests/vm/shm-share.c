@@ -0,0 +1,42 @@
+/* Creates a shared-memory segment, attaches it, and forks a child
+   that sees the parent's stores to it and whose stores to it the
+   parent sees in turn. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define SIZE (2 * 4096)
+
+void
+test_main (void)
+{
+  char *shared = (char *) 0x10000000;
+  shmid_t id;
+  pid_t child;
+  int status;
+
+  CHECK ((id = shm_create (SIZE, 0)) != SHM_FAILED, "shm_create");
+  CHECK (shm_attach (id, shared) == shared, "shm_attach");
+  memset (shared, 'p', SIZE);
+
+  CHECK ((child = fork ()) != PID_ERROR, "fork");
+  if (child == 0)
+    {
+      size_t i;
+
+      for (i = 0; i < SIZE; i++)
+        if (shared[i] != 'p')
+          fail ("child sees byte %zu as %d", i, shared[i]);
+      memset (shared, 'c', SIZE);
+      exit (0);
+    }
+
+  status = wait (child);
+  CHECK (status == 0, "wait for child (must return 0)");
+  CHECK (shared[0] == 'c' && shared[SIZE - 1] == 'c',
+         "parent sees child's stores");
+  CHECK (shm_detach (shared), "shm_detach");
+  CHECK (!shm_detach (shared), "second shm_detach fails");
+}
@@ -0,0 +1,18 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(shm-share) begin
+(shm-share) shm_create
+(shm-share) shm_attach
+(shm-share) fork
+shm-share: exit(0)
+(shm-share) wait for child (must return 0)
+(shm-share) parent sees child's stores
+(shm-share) shm_detach
+(shm-share) second shm_detach fails
+(shm-share) end
+shm-share: exit(0)
+EOF
+pass;
@@ -34,9 +34,16 @@
 #ifdef FILESYS
 #include "devices/block.h"
 #include "devices/ide.h"
+#include "filesys/cache.h"
 #include "filesys/filesys.h"
 #include "filesys/fsutil.h"
 #endif
+#ifdef VM
+#include "vm/frame.h"
+#include "vm/page.h"
+#include "vm/shm.h"
+#include "vm/swap.h"
+#endif
 
 /* Page directory with kernel mappings only. */
 uint32_t *init_page_dir;
@@ -127,6 +134,13 @@ main (void)
   filesys_init (format_filesys);
 #endif
 
+#ifdef VM
+  /* Initialize virtual memory. */
+  frame_init ();
+  swap_init ();
+  shm_init ();
+#endif
+
   printf ("Boot complete.\n");
 
   /* Run actions specified on kernel command line. */
@@ -150,16 +164,40 @@ bss_init (void)
   memset (&_start_bss, 0, &_end_bss - &_start_bss);
 }
 
+/* CPUID.1:EDX bit indicating support for 4 MB pages, and the CR4
+   bit that enables them.  See [IA32-v3a] 3.7.3 "Mixing 4-KByte
+   and 4-MByte Pages". */
+#define CPUID_PSE 0x00000008    /* Page Size Extension supported. */
+#define CR4_PSE 0x00000010      /* Page Size Extension enable. */
+
+/* Returns true if the CPU supports 4 MB pages. */
+static bool
+cpu_has_pse (void)
+{
+  uint32_t eax = 1, ebx, ecx, edx;
+
+  asm ("cpuid" : "+a" (eax), "=b" (ebx), "=c" (ecx), "=d" (edx));
+  return (edx & CPUID_PSE) != 0;
+}
+
 /* Populates the base page directory and page table with the
    kernel virtual mapping, and then sets up the CPU to use the
    new page directory.  Points init_page_dir to the page
-   directory it creates. */
+   directory it creates.
+
+   If the CPU supports it, each 4 MB region of RAM is mapped by
+   a single large page, which needs no page table and only one
+   TLB entry.  Regions containing kernel text, which must stay
+   read-only, and the last, partial region still get page
+   tables.  User page directories copy these PDEs, so every
+   process shares the same kernel mapping. */
 static void
 paging_init (void)
 {
   uint32_t *pd, *pt;
   size_t page;
   extern char _start, _end_kernel_text;
+  bool pse = cpu_has_pse ();
 
   pd = init_page_dir = palloc_get_page (PAL_ASSERT | PAL_ZERO);
   pt = NULL;
@@ -171,6 +209,15 @@ paging_init (void)
       size_t pte_idx = pt_no (vaddr);
       bool in_kernel_text = &_start <= vaddr && vaddr < &_end_kernel_text;
 
+      if (pse && pte_idx == 0
+          && init_ram_pages - page >= PTSPAN / PGSIZE
+          && (vaddr >= &_end_kernel_text || vaddr + PTSPAN <= &_start))
+        {
+          pd[pde_idx] = pde_create_large (paddr, true);
+          page += PTSPAN / PGSIZE - 1;
+          continue;
+        }
+
       if (pd[pde_idx] == 0)
         {
           pt = palloc_get_page (PAL_ASSERT | PAL_ZERO);
@@ -180,6 +227,15 @@ paging_init (void)
       pt[pte_idx] = pte_create_kernel (vaddr, !in_kernel_text);
     }
 
+  /* Large pages must be enabled before a page directory that
+     uses them is loaded. */
+  if (pse)
+    {
+      uint32_t cr4;
+      asm volatile ("movl %%cr4, %0" : "=r" (cr4));
+      asm volatile ("movl %0, %%cr4" : : "r" (cr4 | CR4_PSE));
+    }
+
   /* Store the physical address of the page directory into CR3
      aka PDBR (page directory base register).  This activates our
      new page tables immediately.  See [IA32-v2a] "MOV--Move
@@ -247,6 +303,10 @@ parse_options (char **argv)
         filesys_bdev_name = value;
       else if (!strcmp (name, "-scratch"))
         scratch_bdev_name = value;
+      else if (!strcmp (name, "-cache"))
+        cache_size = atoi (value);
+      else if (!strcmp (name, "-crash"))
+        filesys_crash = true;
 #ifdef VM
       else if (!strcmp (name, "-swap"))
         swap_bdev_name = value;
@@ -259,6 +319,10 @@ parse_options (char **argv)
 #ifdef USERPROG
       else if (!strcmp (name, "-ul"))
         user_page_limit = atoi (value);
+#endif
+#ifdef VM
+      else if (!strcmp (name, "-sl"))
+        stack_page_limit = atoi (value);
 #endif
       else
         PANIC ("unknown option `%s' (use -h for help)", name);
@@ -374,6 +438,8 @@ usage (void)
           "  -f                 Format file system device during startup.\n"
           "  -filesys=BDEV      Use BDEV for file system instead of default.\n"
           "  -scratch=BDEV      Use BDEV for scratch instead of default.\n"
+          "  -cache=COUNT       Cache COUNT file system sectors (default 64).\n"
+          "  -crash             Power off without writing back file system.\n"
 #ifdef VM
           "  -swap=BDEV         Use BDEV for swap instead of default.\n"
 #endif
@@ -382,6 +448,9 @@ usage (void)
           "  -mlfqs             Use multi-level feedback queue scheduler.\n"
 #ifdef USERPROG
           "  -ul=COUNT          Limit user memory to COUNT pages.\n"
+#endif
+#ifdef VM
+          "  -sl=COUNT          Limit each user stack to COUNT pages.\n"
 #endif
           );
   shutdown_power_off ();
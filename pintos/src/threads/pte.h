@@ -66,6 +66,7 @@ static inline uintptr_t pd_no (const void *va) {
 #define PTE_U 0x4               /* 1=user/kernel, 0=kernel only. */
 #define PTE_A 0x20              /* 1=accessed, 0=not acccessed. */
 #define PTE_D 0x40              /* 1=dirty, 0=not dirty (PTEs only). */
+#define PDE_PS 0x80             /* 1=4 MB page, 0=page table (PDEs only). */
 
 /* Returns a PDE that points to page table PT. */
 static inline uint32_t pde_create (uint32_t *pt) {
@@ -73,10 +74,21 @@ static inline uint32_t pde_create (uint32_t *pt) {
   return vtop (pt) | PTE_U | PTE_P | PTE_W;
 }
 
+/* Returns a PDE that maps the PTSPAN bytes of physical memory
+   starting at PADDR, which must be PTSPAN-aligned, as a single
+   large page.  The page is readable; if WRITABLE is true then it
+   will be writable as well.  The page will be usable only by
+   ring 0 code.  Large pages only work with CR4.PSE set. */
+static inline uint32_t pde_create_large (uintptr_t paddr, bool writable) {
+  ASSERT (paddr % PTSPAN == 0);
+  return paddr | PDE_PS | PTE_P | (writable ? PTE_W : 0);
+}
+
 /* Returns a pointer to the page table that page directory entry
-   PDE, which must "present", points to. */
+   PDE, which must "present" and not a large page, points to. */
 static inline uint32_t *pde_get_pt (uint32_t pde) {
   ASSERT (pde & PTE_P);
+  ASSERT (!(pde & PDE_PS));
   return ptov (pde & PTE_ADDR);
 }
 
@@ -336,3 +336,65 @@ cond_broadcast (struct condition *cond, struct lock *lock)
   while (!list_empty (&cond->waiters))
     cond_signal (cond, lock);
 }
+
+/* Initializes wait queue Q as empty. */
+void
+waitq_init (struct waitq *q)
+{
+  ASSERT (q != NULL);
+
+  list_init (&q->entries);
+}
+
+/* Adds E to Q, so that waking Q ups SEMA, until E is removed
+   with waitq_remove().  E must not already be in a queue. */
+void
+waitq_add (struct waitq *q, struct waitq_entry *e, struct semaphore *sema)
+{
+  enum intr_level old_level;
+
+  ASSERT (q != NULL);
+  ASSERT (e != NULL);
+  ASSERT (sema != NULL);
+
+  old_level = intr_disable ();
+  e->sema = sema;
+  e->queued = true;
+  list_push_back (&q->entries, &e->elem);
+  intr_set_level (old_level);
+}
+
+/* Removes E from its queue, if it is in one. */
+void
+waitq_remove (struct waitq_entry *e)
+{
+  enum intr_level old_level;
+
+  ASSERT (e != NULL);
+
+  old_level = intr_disable ();
+  if (e->queued)
+    {
+      list_remove (&e->elem);
+      e->queued = false;
+    }
+  intr_set_level (old_level);
+}
+
+/* Ups the semaphore of every entry in Q.  The entries stay in Q.
+
+   This function may be called from an interrupt handler. */
+void
+waitq_wake (struct waitq *q)
+{
+  enum intr_level old_level;
+  struct list_elem *e;
+
+  ASSERT (q != NULL);
+
+  old_level = intr_disable ();
+  for (e = list_begin (&q->entries); e != list_end (&q->entries);
+       e = list_next (e))
+    sema_up (list_entry (e, struct waitq_entry, elem)->sema);
+  intr_set_level (old_level);
+}
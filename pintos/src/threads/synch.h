@@ -41,6 +41,30 @@ void cond_wait (struct condition *, struct lock *);
 void cond_signal (struct condition *, struct lock *);
 void cond_broadcast (struct condition *, struct lock *);
 
+/* Wait queue.
+
+   Lets a thread wait on several objects at once, as for poll().
+   The thread adds an entry naming its semaphore to the wait queue
+   of each object, and the object "ups" every such semaphore when
+   its state changes.  Entries may be added and removed, and
+   queues woken, from interrupt handlers. */
+struct waitq
+  {
+    struct list entries;        /* List of waitq_entry. */
+  };
+
+struct waitq_entry
+  {
+    struct list_elem elem;      /* Element in waitq's list. */
+    struct semaphore *sema;     /* Upped when the queue is woken. */
+    bool queued;                /* In a queue? */
+  };
+
+void waitq_init (struct waitq *);
+void waitq_add (struct waitq *, struct waitq_entry *, struct semaphore *);
+void waitq_remove (struct waitq_entry *);
+void waitq_wake (struct waitq *);
+
 /* Optimization barrier.
 
    The compiler will not reorder operations across an
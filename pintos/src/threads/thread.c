@@ -489,6 +489,11 @@ init_thread (struct thread *t, const char *name, int priority)
   sema_init (&(t->child_sem), 0);
   list_init(&(t->child_processes));
   list_push_back(&(running_thread()->child_processes), &(t->child_elem));
+#ifdef VM
+  list_init (&t->mappings);
+  t->next_mapid = 0;
+  list_init (&t->shm);
+#endif
 
   old_level = intr_disable ();
   list_push_back (&all_list, &t->allelem);
@@ -564,12 +569,6 @@ thread_schedule_tail (struct thread *prev)
   if (prev != NULL && prev->status == THREAD_DYING && prev != initial_thread)
     {
       ASSERT (prev != cur);
-      int i;
-      for (i = 0; i < MAX_FILE_DESCRIPTORS; ++i) {
-        if (prev->fdtable[i] != NULL) {
-          file_close(prev->fdtable[i]);
-        }
-      } 
       if (prev->is_orphan) palloc_free_page (prev);
     }
 }
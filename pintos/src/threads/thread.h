@@ -6,6 +6,9 @@
 #include <stdint.h>
 #include "threads/synch.h"
 #include "threads/fixed-point.h"
+#ifdef VM
+#include <hash.h>
+#endif
 
 /* States in a thread's life cycle. */
 enum thread_status
@@ -26,9 +29,6 @@ typedef int tid_t;
 #define PRI_DEFAULT 31                  /* Default priority. */
 #define PRI_MAX 63                      /* Highest priority. */
 
-/* Process File Descriptors */
-#define MAX_FILE_DESCRIPTORS 128
-
 /* Maximum number of threads allowed by the system */
 #define MAX_THREAD_LIMIT 40
 
@@ -117,7 +117,27 @@ struct thread
     /* Owned by userprog/process.c. */
     uint32_t *pagedir;                  /* Page directory. */
 
-    struct file* fdtable[MAX_FILE_DESCRIPTORS];    /* File descriptors table. */
+    struct fdtable *fdtable;            /* File descriptor table. */
+#endif
+
+#ifdef FILESYS
+    /* Owned by filesys/journal.c. */
+    int journal_depth;                  /* Nested journal_begin() calls. */
+    size_t journal_credits;             /* Sectors the operation may add. */
+#endif
+
+#ifdef VM
+    /* Owned by vm/page.c. */
+    struct hash pages;                  /* Supplemental page table. */
+    struct file *exec_file;             /* Executable, backs code pages. */
+    void *user_esp;                     /* User stack pointer in syscall. */
+
+    /* Owned by vm/mmap.c. */
+    struct list mappings;               /* Memory-mapped files. */
+    int next_mapid;                     /* Next mapping identifier. */
+
+    /* Owned by vm/shm.c. */
+    struct list shm;                    /* Shared-memory attachments. */
 #endif
 
     /* Owned by thread.c. */
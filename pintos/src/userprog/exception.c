@@ -2,8 +2,13 @@
 #include <inttypes.h>
 #include <stdio.h>
 #include "userprog/gdt.h"
+#include "userprog/uaccess.h"
 #include "threads/interrupt.h"
 #include "threads/thread.h"
+#include "threads/vaddr.h"
+#ifdef VM
+#include "vm/page.h"
+#endif
 
 /* Number of page faults processed. */
 static long long page_fault_cnt;
@@ -152,6 +157,29 @@ page_fault (struct intr_frame *f)
   write = (f->error_code & PF_W) != 0;
   user = (f->error_code & PF_U) != 0;
 
+#ifdef VM
+  /* A not-present page that belongs to the process's address
+     space, or that extends its stack, is simply brought in.  In
+     a system call the user stack pointer is the one saved on
+     entry, since F->esp is then a kernel address. */
+  if (not_present && is_user_vaddr (fault_addr)
+      && page_fault_in (fault_addr,
+                        user ? f->esp : thread_current ()->user_esp))
+    return;
+
+  /* A write to a page shared copy-on-write after fork() gets a
+     private copy of the page. */
+  if (!not_present && write && is_user_vaddr (fault_addr)
+      && page_unshare (fault_addr))
+    return;
+#endif
+
+  /* A fault in the kernel on behalf of copy_from_user() and
+     friends resumes at the fixup code, which reports the failure
+     to the system call. */
+  if (!user && uaccess_fixup (f))
+    return;
+
   /* To implement virtual memory, delete the rest of the function
      body, and replace it with code that brings in the page to
      which fault_addr refers. */
@@ -0,0 +1,262 @@
+#include "userprog/fdtable.h"
+#include <bitmap.h>
+#include <debug.h>
+#include <string.h>
+#include "filesys/file.h"
+#include "threads/malloc.h"
+#include "userprog/pipe.h"
+
+/* A process's file descriptor table.
+
+   The table lives outside struct thread, which shares its page
+   with the kernel stack, and starts small.  It doubles in size
+   when every descriptor is in use, up to FD_MAX.
+
+   A bitmap records the descriptors in use, and NEXT_FD is a
+   lower bound on the lowest free descriptor.  open() therefore
+   returns the lowest free descriptor, as POSIX requires.  It
+   usually finds that descriptor at NEXT_FD itself, without
+   scanning.
+
+   Finding a descriptor is not O(1) in general, though: once a
+   low descriptor is closed and reused, NEXT_FD moves past it
+   and the next open() scans the descriptors in use above it.
+   bitmap_scan() skips them a word at a time, so that costs at
+   most FD_MAX / 32 word tests.  A free list would be O(1) but
+   could not hand out the lowest free descriptor.
+
+   A descriptor refers to an open file or to one end of a pipe. */
+struct fd
+  {
+    struct file *file;          /* Open file, or null. */
+    struct pipe *pipe;          /* Pipe, or null. */
+    bool write_end;             /* For a pipe, the write end? */
+  };
+
+struct fdtable
+  {
+    struct fd *fds;             /* Descriptors. */
+    struct bitmap *used;        /* Descriptors in use. */
+    size_t size;                /* Number of descriptors in FDS, USED. */
+    size_t next_fd;             /* No descriptor below this is free. */
+  };
+
+/* Initial number of descriptors in a table. */
+#define FD_INIT 32
+
+static int install (struct fdtable *, struct fd);
+static void close_fd (struct fd *);
+static bool resize (struct fdtable *, size_t size);
+
+/* Creates and returns a table of SIZE descriptors, all free, or
+   a null pointer if memory is not available. */
+static struct fdtable *
+create (size_t size)
+{
+  struct fdtable *fdt = malloc (sizeof *fdt);
+  if (fdt == NULL)
+    return NULL;
+
+  fdt->fds = calloc (size, sizeof *fdt->fds);
+  fdt->used = bitmap_create (size);
+  if (fdt->fds == NULL || fdt->used == NULL)
+    {
+      free (fdt->fds);
+      if (fdt->used != NULL)
+        bitmap_destroy (fdt->used);
+      free (fdt);
+      return NULL;
+    }
+  fdt->size = size;
+  fdt->next_fd = 0;
+  return fdt;
+}
+
+/* Creates and returns a table for a new process, with only the
+   console descriptors in use.  Returns a null pointer if memory
+   is not available. */
+struct fdtable *
+fdtable_create (void)
+{
+  struct fdtable *fdt = create (FD_INIT);
+  if (fdt != NULL)
+    {
+      bitmap_mark (fdt->used, STDIN_FILENO);
+      bitmap_mark (fdt->used, STDOUT_FILENO);
+      fdt->next_fd = 2;
+    }
+  return fdt;
+}
+
+/* Creates and returns a copy of PARENT for a child created by
+   fork(), sharing each of PARENT's open files and pipes.  Returns
+   a null pointer if memory is not available. */
+struct fdtable *
+fdtable_fork (const struct fdtable *parent)
+{
+  struct fdtable *fdt = create (parent->size);
+  size_t fd;
+
+  if (fdt == NULL)
+    return NULL;
+  for (fd = 0; fd < parent->size; fd++)
+    if (bitmap_test (parent->used, fd))
+      {
+        const struct fd *pfd = &parent->fds[fd];
+
+        bitmap_mark (fdt->used, fd);
+        fdt->fds[fd] = *pfd;
+        if (pfd->file != NULL)
+          file_dup (pfd->file);
+        else if (pfd->pipe != NULL)
+          pipe_dup (pfd->pipe, pfd->write_end);
+      }
+  fdt->next_fd = parent->next_fd;
+  return fdt;
+}
+
+/* Closes every file and pipe open in FDT and frees it.  FDT may
+   be a null pointer. */
+void
+fdtable_destroy (struct fdtable *fdt)
+{
+  size_t fd;
+
+  if (fdt == NULL)
+    return;
+  for (fd = 0; fd < fdt->size; fd++)
+    close_fd (&fdt->fds[fd]);
+  bitmap_destroy (fdt->used);
+  free (fdt->fds);
+  free (fdt);
+}
+
+/* Installs FILE in FDT at the lowest free descriptor and returns
+   the descriptor, or -1 if FDT is full. */
+int
+fdtable_install (struct fdtable *fdt, struct file *file)
+{
+  struct fd new = {file, NULL, false};
+
+  ASSERT (file != NULL);
+  return install (fdt, new);
+}
+
+/* Installs the read or, if WRITE_END, the write end of PIPE in
+   FDT at the lowest free descriptor and returns the descriptor,
+   or -1 if FDT is full. */
+int
+fdtable_install_pipe (struct fdtable *fdt, struct pipe *pipe,
+                      bool write_end)
+{
+  struct fd new = {NULL, pipe, write_end};
+
+  ASSERT (pipe != NULL);
+  return install (fdt, new);
+}
+
+/* Returns the file open as descriptor FD in FDT, or a null
+   pointer if there is none. */
+struct file *
+fdtable_get (const struct fdtable *fdt, int fd)
+{
+  if (fd < 0 || (size_t) fd >= fdt->size)
+    return NULL;
+  return fdt->fds[fd].file;
+}
+
+/* Returns the pipe whose read or, if WRITE_END, write end is open
+   as descriptor FD in FDT, or a null pointer if there is none. */
+struct pipe *
+fdtable_get_pipe (const struct fdtable *fdt, int fd, bool write_end)
+{
+  if (fd < 0 || (size_t) fd >= fdt->size
+      || fdt->fds[fd].write_end != write_end)
+    return NULL;
+  return fdt->fds[fd].pipe;
+}
+
+/* Closes descriptor FD in FDT, with the file or pipe end open as
+   FD.  Returns true if successful, false if FD was not open. */
+bool
+fdtable_close (struct fdtable *fdt, int fd)
+{
+  struct fd *f;
+
+  if (fd < 0 || (size_t) fd >= fdt->size)
+    return false;
+  f = &fdt->fds[fd];
+  if (f->file == NULL && f->pipe == NULL)
+    return false;
+
+  close_fd (f);
+  bitmap_reset (fdt->used, fd);
+  if ((size_t) fd < fdt->next_fd)
+    fdt->next_fd = fd;
+  return true;
+}
+
+/* Installs NEW in FDT at the lowest free descriptor and returns
+   the descriptor, or -1 if FDT is full. */
+static int
+install (struct fdtable *fdt, struct fd new)
+{
+  size_t fd;
+
+  fd = bitmap_scan (fdt->used, fdt->next_fd, 1, false);
+  if (fd == BITMAP_ERROR)
+    {
+      fd = fdt->size;
+      if (fdt->size >= FD_MAX
+          || !resize (fdt, fdt->size * 2 < FD_MAX ? fdt->size * 2 : FD_MAX))
+        return -1;
+    }
+  bitmap_mark (fdt->used, fd);
+  fdt->fds[fd] = new;
+  fdt->next_fd = fd + 1;
+  return fd;
+}
+
+/* Closes the file or pipe end in F, if any, and clears F. */
+static void
+close_fd (struct fd *f)
+{
+  if (f->file != NULL)
+    file_close (f->file);
+  else if (f->pipe != NULL)
+    pipe_close (f->pipe, f->write_end);
+  f->file = NULL;
+  f->pipe = NULL;
+}
+
+/* Grows FDT to SIZE descriptors.  Returns true if successful,
+   false if memory is not available. */
+static bool
+resize (struct fdtable *fdt, size_t size)
+{
+  struct fd *fds;
+  struct bitmap *used;
+  size_t fd;
+
+  ASSERT (size > fdt->size);
+
+  used = bitmap_create (size);
+  if (used == NULL)
+    return false;
+  fds = realloc (fdt->fds, size * sizeof *fds);
+  if (fds == NULL)
+    {
+      bitmap_destroy (used);
+      return false;
+    }
+  memset (fds + fdt->size, 0, (size - fdt->size) * sizeof *fds);
+  for (fd = 0; fd < fdt->size; fd++)
+    if (bitmap_test (fdt->used, fd))
+      bitmap_mark (used, fd);
+  bitmap_destroy (fdt->used);
+
+  fdt->fds = fds;
+  fdt->used = used;
+  fdt->size = size;
+  return true;
+}
@@ -0,0 +1,28 @@
+#ifndef USERPROG_FDTABLE_H
+#define USERPROG_FDTABLE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+struct file;
+struct pipe;
+
+/* File descriptors 0 and 1, reserved for the console. */
+#define STDIN_FILENO 0
+#define STDOUT_FILENO 1
+
+/* Maximum number of file descriptors per process. */
+#define FD_MAX 4096
+
+struct fdtable *fdtable_create (void);
+struct fdtable *fdtable_fork (const struct fdtable *);
+void fdtable_destroy (struct fdtable *);
+
+int fdtable_install (struct fdtable *, struct file *);
+int fdtable_install_pipe (struct fdtable *, struct pipe *, bool write_end);
+struct file *fdtable_get (const struct fdtable *, int fd);
+struct pipe *fdtable_get_pipe (const struct fdtable *, int fd,
+                               bool write_end);
+bool fdtable_close (struct fdtable *, int fd);
+
+#endif /* userprog/fdtable.h */
@@ -0,0 +1,316 @@
+#include "userprog/pipe.h"
+#include <debug.h>
+#include <poll.h>
+#include <stdint.h>
+#include <string.h>
+#include "threads/malloc.h"
+#include "threads/palloc.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
+#include "userprog/pagedir.h"
+
+/* Anonymous pipes.
+
+   A pipe buffers data in a ring of PIPE_PAGES kernel pages.
+   Readers block while the ring is empty and some writer remains,
+   and writers block while it is full and some reader remains.
+
+   A reader that finds the ring empty leaves a description of its
+   buffer in the pipe before it sleeps.  A writer that finds such
+   a reader, and the ring still empty, copies straight from its
+   own buffer into the reader's, without going through the ring.
+   The reader's buffer is in another address space, so the writer
+   reaches it through the kernel mapping of the frames behind it.
+   Those frames must stay put until the read finishes, so callers
+   must pass user buffers that are resident, e.g. pinned. */
+
+/* A reader sleeping on an empty pipe, waiting for a writer to
+   fill its buffer directly. */
+struct pipe_reader
+  {
+    uint32_t *pagedir;          /* Reader's page directory. */
+    uint8_t *ubuf;              /* Reader's buffer, a user address. */
+    size_t size;                /* Size of UBUF. */
+    size_t done;                /* Bytes written to UBUF so far. */
+  };
+
+/* A pipe. */
+struct pipe
+  {
+    struct lock lock;           /* Protects all members. */
+    struct condition readable;  /* Signaled when data or EOF arrives. */
+    struct condition writable;  /* Signaled when space frees up. */
+    uint8_t *pages[PIPE_PAGES]; /* Ring buffer. */
+    size_t head;                /* Total bytes ever written to ring. */
+    size_t tail;                /* Total bytes ever read from ring. */
+    int readers;                /* Open read ends. */
+    int writers;                /* Open write ends. */
+    struct pipe_reader *reader; /* Reader awaiting direct transfer. */
+    struct waitq waitq;         /* Woken on any change, for poll(). */
+  };
+
+static void pipe_free (struct pipe *);
+
+/* Creates a pipe with one read end and one write end open.
+   Returns the new pipe, or a null pointer if memory is not
+   available. */
+struct pipe *
+pipe_create (void)
+{
+  struct pipe *p = calloc (1, sizeof *p);
+  int i;
+
+  if (p == NULL)
+    return NULL;
+  for (i = 0; i < PIPE_PAGES; i++)
+    {
+      p->pages[i] = palloc_get_page (0);
+      if (p->pages[i] == NULL)
+        {
+          pipe_free (p);
+          return NULL;
+        }
+    }
+  lock_init (&p->lock);
+  cond_init (&p->readable);
+  cond_init (&p->writable);
+  waitq_init (&p->waitq);
+  p->readers = p->writers = 1;
+  return p;
+}
+
+/* Opens another handle on the read or, if WRITE_END, the write
+   end of P, as for a descriptor inherited across fork(). */
+void
+pipe_dup (struct pipe *p, bool write_end)
+{
+  lock_acquire (&p->lock);
+  if (write_end)
+    p->writers++;
+  else
+    p->readers++;
+  lock_release (&p->lock);
+}
+
+/* Closes a handle on the read or, if WRITE_END, the write end of
+   P, and frees P once both ends are fully closed. */
+void
+pipe_close (struct pipe *p, bool write_end)
+{
+  bool unused;
+
+  lock_acquire (&p->lock);
+  if (write_end)
+    p->writers--;
+  else
+    p->readers--;
+  ASSERT (p->readers >= 0 && p->writers >= 0);
+
+  /* Readers may now see end of file, writers a broken pipe. */
+  cond_broadcast (&p->readable, &p->lock);
+  cond_broadcast (&p->writable, &p->lock);
+  waitq_wake (&p->waitq);
+  unused = p->readers == 0 && p->writers == 0;
+  lock_release (&p->lock);
+
+  if (unused)
+    pipe_free (p);
+}
+
+/* Frees P and its ring buffer. */
+static void
+pipe_free (struct pipe *p)
+{
+  int i;
+
+  for (i = 0; i < PIPE_PAGES; i++)
+    palloc_free_page (p->pages[i]);
+  free (p);
+}
+
+/* Copies SIZE bytes between user buffer UBUF and the ring of P
+   at ring position POS, in the direction given by TO_RING. */
+static void
+ring_copy (struct pipe *p, size_t pos, uint8_t *ubuf, size_t size,
+           bool to_ring)
+{
+  while (size > 0)
+    {
+      size_t ofs = pos % PIPE_SIZE;
+      uint8_t *kaddr = p->pages[ofs / PGSIZE] + ofs % PGSIZE;
+      size_t chunk = PGSIZE - ofs % PGSIZE;
+      if (chunk > size)
+        chunk = size;
+
+      if (to_ring)
+        memcpy (kaddr, ubuf, chunk);
+      else
+        memcpy (ubuf, kaddr, chunk);
+      pos += chunk;
+      ubuf += chunk;
+      size -= chunk;
+    }
+}
+
+/* Copies up to SIZE bytes from UBUF, in the current process,
+   straight into the buffer of the reader waiting on P.  Returns
+   the number of bytes copied. */
+static size_t
+direct_copy (struct pipe *p, const uint8_t *ubuf, size_t size)
+{
+  struct pipe_reader *r = p->reader;
+  size_t copied = 0;
+
+  if (size > r->size - r->done)
+    size = r->size - r->done;
+  while (copied < size)
+    {
+      uint8_t *udst = r->ubuf + r->done;
+      uint8_t *kdst = pagedir_get_page (r->pagedir, udst);
+      size_t chunk = PGSIZE - pg_ofs (udst);
+      if (chunk > size - copied)
+        chunk = size - copied;
+
+      ASSERT (kdst != NULL);
+      memcpy (kdst, ubuf + copied, chunk);
+
+      /* Writing through the kernel mapping leaves the reader's
+         dirty bit clear, which would let eviction drop the data. */
+      pagedir_set_dirty (r->pagedir, udst, true);
+      r->done += chunk;
+      copied += chunk;
+    }
+  return copied;
+}
+
+/* Reads up to SIZE bytes from P into UBUF, a resident user
+   buffer.  Sleeps until at least one byte is available, or until
+   no writer remains.  Returns the number of bytes read, which is
+   0 at end of file. */
+int
+pipe_read (struct pipe *p, void *ubuf, size_t size)
+{
+  struct pipe_reader r;
+  size_t avail;
+
+  if (size == 0)
+    return 0;
+
+  lock_acquire (&p->lock);
+  while (p->head == p->tail && p->writers > 0)
+    {
+      if (p->reader == NULL)
+        {
+          /* Offer our buffer to the next writer. */
+          r.pagedir = thread_current ()->pagedir;
+          r.ubuf = ubuf;
+          r.size = size;
+          r.done = 0;
+          p->reader = &r;
+          while (p->reader == &r && r.done == 0 && p->writers > 0)
+            cond_wait (&p->readable, &p->lock);
+          if (p->reader == &r)
+            p->reader = NULL;
+          if (r.done > 0)
+            {
+              /* Let another reader offer its buffer. */
+              cond_broadcast (&p->readable, &p->lock);
+              lock_release (&p->lock);
+              return r.done;
+            }
+        }
+      else
+        cond_wait (&p->readable, &p->lock);
+    }
+
+  avail = p->head - p->tail;
+  if (size > avail)
+    size = avail;
+  ring_copy (p, p->tail, ubuf, size, false);
+  p->tail += size;
+  if (size > 0)
+    {
+      cond_broadcast (&p->writable, &p->lock);
+      waitq_wake (&p->waitq);
+    }
+  lock_release (&p->lock);
+  return size;
+}
+
+/* Writes SIZE bytes from UBUF, a resident user buffer, to P.
+   Sleeps while the pipe is full.  Returns the number of bytes
+   written, which is less than SIZE only if the last reader
+   closed the pipe meanwhile, or -1 if no reader remained to
+   begin with. */
+int
+pipe_write (struct pipe *p, const void *ubuf_, size_t size)
+{
+  const uint8_t *ubuf = ubuf_;
+  size_t written = 0;
+
+  lock_acquire (&p->lock);
+  if (p->readers == 0)
+    {
+      lock_release (&p->lock);
+      return -1;
+    }
+
+  while (written < size && p->readers > 0)
+    {
+      size_t space = PIPE_SIZE - (p->head - p->tail);
+      size_t chunk;
+
+      if (p->reader != NULL && p->head == p->tail)
+        {
+          /* Hand the data to the waiting reader. */
+          written += direct_copy (p, ubuf + written, size - written);
+          p->reader = NULL;
+          cond_broadcast (&p->readable, &p->lock);
+        }
+      else if (space > 0)
+        {
+          chunk = size - written < space ? size - written : space;
+          ring_copy (p, p->head, (uint8_t *) ubuf + written, chunk, true);
+          p->head += chunk;
+          written += chunk;
+          cond_broadcast (&p->readable, &p->lock);
+          waitq_wake (&p->waitq);
+        }
+      else
+        cond_wait (&p->writable, &p->lock);
+    }
+  lock_release (&p->lock);
+  return written;
+}
+
+/* Returns the poll() events, POLLIN, POLLOUT, POLLERR, or POLLHUP,
+   pending on the read or, if WRITE_END, the write end of P.  If E
+   is nonnull, also adds it to the queue of entries whose SEMA is
+   upped whenever P changes. */
+int
+pipe_poll (struct pipe *p, bool write_end, struct waitq_entry *e,
+           struct semaphore *sema)
+{
+  int revents = 0;
+
+  lock_acquire (&p->lock);
+  if (e != NULL)
+    waitq_add (&p->waitq, e, sema);
+  if (!write_end)
+    {
+      if (p->head != p->tail)
+        revents |= POLLIN;
+      if (p->writers == 0)
+        revents |= POLLHUP;
+    }
+  else
+    {
+      if (p->readers == 0)
+        revents |= POLLERR;
+      else if (p->head - p->tail < PIPE_SIZE)
+        revents |= POLLOUT;
+    }
+  lock_release (&p->lock);
+  return revents;
+}
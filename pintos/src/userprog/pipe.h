@@ -0,0 +1,26 @@
+#ifndef USERPROG_PIPE_H
+#define USERPROG_PIPE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include "threads/vaddr.h"
+
+struct semaphore;
+struct waitq_entry;
+
+/* Number of pages in a pipe's ring buffer. */
+#define PIPE_PAGES 4
+
+/* Size of a pipe's ring buffer in bytes. */
+#define PIPE_SIZE (PIPE_PAGES * PGSIZE)
+
+struct pipe *pipe_create (void);
+void pipe_dup (struct pipe *, bool write_end);
+void pipe_close (struct pipe *, bool write_end);
+
+int pipe_read (struct pipe *, void *ubuf, size_t size);
+int pipe_write (struct pipe *, const void *ubuf, size_t size);
+int pipe_poll (struct pipe *, bool write_end, struct waitq_entry *,
+               struct semaphore *);
+
+#endif /* userprog/pipe.h */
@@ -0,0 +1,102 @@
+#include "userprog/poll.h"
+#include <debug.h>
+#include "devices/input.h"
+#include "devices/timer.h"
+#include "threads/malloc.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "userprog/fdtable.h"
+#include "userprog/pipe.h"
+
+/* Waiting for readiness on several descriptors.
+
+   poll_fds() adds an entry for each descriptor to the wait queue
+   of the object behind it: the console input buffer or a pipe.
+   All of the entries name one semaphore, which the objects up
+   whenever their state changes, and which a timer alarm ups when
+   the timeout expires.  The caller sleeps on the semaphore
+   between scans of the descriptors, so it uses no CPU while it
+   waits.  Files and console output are always ready. */
+
+/* Returns the events pending on PFD's descriptor, among those it
+   asks for and those always reported.  If E is nonnull, also adds
+   E to the wait queue of the object behind the descriptor, if it
+   has one, to up SEMA when it changes. */
+static int
+fd_poll (const struct pollfd *pfd, struct waitq_entry *e,
+         struct semaphore *sema)
+{
+  struct fdtable *fdt = thread_current ()->fdtable;
+  struct pipe *p;
+  int revents;
+
+  if (pfd->fd < 0)
+    return 0;
+  else if (pfd->fd == STDIN_FILENO)
+    revents = input_poll (e, sema) ? POLLIN : 0;
+  else if (pfd->fd == STDOUT_FILENO)
+    revents = POLLOUT;
+  else if ((p = fdtable_get_pipe (fdt, pfd->fd, false)) != NULL)
+    revents = pipe_poll (p, false, e, sema);
+  else if ((p = fdtable_get_pipe (fdt, pfd->fd, true)) != NULL)
+    revents = pipe_poll (p, true, e, sema);
+  else if (fdtable_get (fdt, pfd->fd) != NULL)
+    revents = POLLIN | POLLOUT;
+  else
+    revents = POLLNVAL;
+
+  return revents & (pfd->events | POLLERR | POLLHUP | POLLNVAL);
+}
+
+/* Waits until at least one of the NFDS descriptors in FDS has one
+   of the events it asks for pending, or for TIMEOUT milliseconds,
+   and sets the REVENTS of each.  A TIMEOUT of 0 does not wait, and
+   a negative TIMEOUT waits indefinitely.  Returns the number of
+   descriptors with events pending, or -1 if memory is not
+   available. */
+int
+poll_fds (struct pollfd *fds, size_t nfds, int timeout)
+{
+  struct waitq_entry *entries = calloc (nfds, sizeof *entries);
+  struct semaphore sema;
+  struct timer_alarm alarm;
+  bool alarm_set = false;
+  bool first = true;
+  int ready;
+  size_t i;
+
+  if (entries == NULL && nfds > 0)
+    return -1;
+
+  sema_init (&sema, 0);
+  for (;;)
+    {
+      /* The first scan also joins the objects' wait queues. */
+      ready = 0;
+      for (i = 0; i < nfds; i++)
+        {
+          fds[i].revents = fd_poll (&fds[i], first ? &entries[i] : NULL,
+                                    &sema);
+          if (fds[i].revents != 0)
+            ready++;
+        }
+      first = false;
+      if (ready > 0 || timeout == 0 || (alarm_set && !alarm.pending))
+        break;
+
+      if (timeout > 0 && !alarm_set)
+        {
+          int64_t ticks = DIV_ROUND_UP ((int64_t) timeout * TIMER_FREQ, 1000);
+          timer_alarm_set (&alarm, ticks, &sema);
+          alarm_set = true;
+        }
+      sema_down (&sema);
+    }
+
+  if (alarm_set)
+    timer_alarm_cancel (&alarm);
+  for (i = 0; i < nfds; i++)
+    waitq_remove (&entries[i]);
+  free (entries);
+  return ready;
+}
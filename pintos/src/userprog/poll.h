@@ -0,0 +1,9 @@
+#ifndef USERPROG_POLL_H
+#define USERPROG_POLL_H
+
+#include <poll.h>
+#include <stddef.h>
+
+int poll_fds (struct pollfd *, size_t nfds, int timeout);
+
+#endif /* userprog/poll.h */
@@ -5,6 +5,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include "userprog/fdtable.h"
 #include "userprog/gdt.h"
 #include "userprog/pagedir.h"
 #include "userprog/tss.h"
@@ -14,10 +15,16 @@
 #include "threads/flags.h"
 #include "threads/init.h"
 #include "threads/interrupt.h"
+#include "threads/malloc.h"
 #include "threads/palloc.h"
 #include "threads/synch.h"
 #include "threads/thread.h"
 #include "threads/vaddr.h"
+#ifdef VM
+#include "vm/mmap.h"
+#include "vm/page.h"
+#include "vm/shm.h"
+#endif
 
 static struct semaphore temporary;
 static thread_func start_process NO_RETURN;
@@ -82,6 +89,11 @@ start_process (void *args_)
   if_.cs = SEL_UCSEG;
   if_.eflags = FLAG_IF | FLAG_MBS;
   success = load (file_name, &if_.eip, &if_.esp);
+  if (success)
+    {
+      thread_current ()->fdtable = fdtable_create ();
+      success = thread_current ()->fdtable != NULL;
+    }
 
   thread_current()->is_loaded = success;
   sema_up(&(thread_current()->load_sem));
@@ -137,6 +149,91 @@ start_process (void *args_)
   NOT_REACHED ();
 }
 
+#ifdef VM
+/* A fork() in progress, handed to the child. */
+struct fork_info
+  {
+    struct thread *parent;      /* Forking process. */
+    struct intr_frame if_;      /* Parent's user context in fork(). */
+  };
+
+static thread_func start_fork NO_RETURN;
+
+/* Starts a new process that is a copy of the current one, and
+   that returns 0 to user context IF_, saved on entry to fork().
+   The copy shares the parent's pages copy-on-write and its open
+   files, including their positions.  The caller must wait on
+   the child's load_sem before touching its user memory again;
+   the child's is_loaded then tells whether the copy succeeded.
+   Returns the new process's thread id, or TID_ERROR if the
+   thread cannot be created. */
+tid_t
+process_fork (const struct intr_frame *if_)
+{
+  struct fork_info *info;
+  tid_t tid;
+
+  info = malloc (sizeof *info);
+  if (info == NULL)
+    return TID_ERROR;
+  info->parent = thread_current ();
+  info->if_ = *if_;
+
+  tid = thread_create (thread_current ()->name, PRI_DEFAULT, start_fork, info);
+  if (tid == TID_ERROR)
+    free (info);
+  return tid;
+}
+
+/* A thread function that copies the address space and file
+   descriptors of the process that called fork() and returns to
+   its user context. */
+static void
+start_fork (void *info_)
+{
+  struct fork_info *info = info_;
+  struct thread *parent = info->parent;
+  struct thread *t = thread_current ();
+  struct intr_frame if_ = info->if_;
+  bool success = false;
+
+  free (info);
+
+  if (page_table_init (&t->pages))
+    {
+      t->pagedir = pagedir_create ();
+      if (t->pagedir == NULL)
+        hash_destroy (&t->pages, NULL);
+    }
+  if (t->pagedir != NULL)
+    {
+      process_activate ();
+      t->exec_file = file_reopen (parent->exec_file);
+      if (t->exec_file != NULL)
+        {
+          file_deny_write (t->exec_file);
+          success = (page_table_fork (parent) && mmap_fork (parent)
+                     && shm_fork (parent));
+        }
+    }
+  if (success)
+    {
+      t->fdtable = fdtable_fork (parent->fdtable);
+      success = t->fdtable != NULL;
+    }
+
+  t->is_loaded = success;
+  sema_up (&t->load_sem);
+  if (!success)
+    thread_exit ();
+
+  /* fork() returns 0 in the child. */
+  if_.eax = 0;
+  asm volatile ("movl %0, %%esp; jmp intr_exit" : : "g" (&if_) : "memory");
+  NOT_REACHED ();
+}
+#endif
+
 /* Waits for thread TID to die and returns its exit status.  If
    it was terminated by the kernel (i.e. killed due to an
    exception), returns -1.  If TID is invalid or if it was not a
@@ -179,11 +276,26 @@ process_exit (void)
   struct thread *cur = thread_current ();
   uint32_t *pd;
 
+  /* Close the process's open files. */
+  fdtable_destroy (cur->fdtable);
+  cur->fdtable = NULL;
+
   /* Destroy the current process's page directory and switch back
      to the kernel-only page directory. */
   pd = cur->pagedir;
   if (pd != NULL)
     {
+#ifdef VM
+      /* Write back mapped files, then release frames and swap
+         slots, before the page directory that maps them goes
+         away. */
+      mmap_unmap_all ();
+      shm_detach_all ();
+      page_table_destroy (&cur->pages);
+      file_close (cur->exec_file);
+      cur->exec_file = NULL;
+#endif
+
       /* Correct ordering here is crucial.  We must set
          cur->pagedir to NULL before switching page directories,
          so that a timer interrupt can't switch back to the
@@ -298,9 +410,18 @@ load (const char *file_name, void (**eip) (void), void **esp)
   int i;
 
   /* Allocate and activate page directory. */
+#ifdef VM
+  if (!page_table_init (&t->pages))
+    goto done;
+#endif
   t->pagedir = pagedir_create ();
   if (t->pagedir == NULL)
-    goto done;
+    {
+#ifdef VM
+      hash_destroy (&t->pages, NULL);
+#endif
+      goto done;
+    }
   process_activate ();
 
   /* Open executable file. */
@@ -394,13 +515,26 @@ load (const char *file_name, void (**eip) (void), void **esp)
 
  done:
   /* We arrive here whether the load is successful or not. */
+#ifdef VM
+  /* Code and data pages are read in lazily from the executable,
+     so keep it open (and unwritable) for the life of the
+     process.  process_exit() closes it. */
+  if (t->pagedir != NULL && file != NULL)
+    {
+      file_deny_write (file);
+      t->exec_file = file;
+      return success;
+    }
+#endif
   file_close (file);
   return success;
 }
 
 /* load() helpers. */
 
+#ifndef VM
 static bool install_page (void *upage, void *kpage, bool writable);
+#endif
 
 /* Checks whether PHDR describes a valid, loadable segment in
    FILE and returns true if so, false otherwise. */
@@ -469,6 +603,27 @@ load_segment (struct file *file, off_t ofs, uint8_t *upage,
   ASSERT (pg_ofs (upage) == 0);
   ASSERT (ofs % PGSIZE == 0);
 
+#ifdef VM
+  /* Just record where each page comes from; page_fault_in()
+     reads it in on first access. */
+  while (read_bytes > 0 || zero_bytes > 0)
+    {
+      size_t page_read_bytes = read_bytes < PGSIZE ? read_bytes : PGSIZE;
+      size_t page_zero_bytes = PGSIZE - page_read_bytes;
+      bool success = (page_read_bytes > 0
+                      ? page_add_file (upage, file, ofs, page_read_bytes,
+                                       writable)
+                      : page_add_zero (upage, writable));
+      if (!success)
+        return false;
+
+      read_bytes -= page_read_bytes;
+      zero_bytes -= page_zero_bytes;
+      ofs += page_read_bytes;
+      upage += PGSIZE;
+    }
+  return true;
+#else
   file_seek (file, ofs);
   while (read_bytes > 0 || zero_bytes > 0)
     {
@@ -504,6 +659,7 @@ load_segment (struct file *file, off_t ofs, uint8_t *upage,
       upage += PGSIZE;
     }
   return true;
+#endif
 }
 
 /* Create a minimal stack by mapping a zeroed page at the top of
@@ -511,6 +667,13 @@ load_segment (struct file *file, off_t ofs, uint8_t *upage,
 static bool
 setup_stack (void **esp)
 {
+#ifdef VM
+  uint8_t *upage = ((uint8_t *) PHYS_BASE) - PGSIZE;
+  if (!page_add_zero (upage, true) || !page_fault_in (upage, PHYS_BASE))
+    return false;
+  *esp = PHYS_BASE;
+  return true;
+#else
   uint8_t *kpage;
   bool success = false;
 
@@ -524,8 +687,10 @@ setup_stack (void **esp)
         palloc_free_page (kpage);
     }
   return success;
+#endif
 }
 
+#ifndef VM
 /* Adds a mapping from user virtual address UPAGE to kernel
    virtual address KPAGE to the page table.
    If WRITABLE is true, the user process may modify the page;
@@ -545,3 +710,4 @@ install_page (void *upage, void *kpage, bool writable)
   return (pagedir_get_page (t->pagedir, upage) == NULL
           && pagedir_set_page (t->pagedir, upage, kpage, writable));
 }
+#endif
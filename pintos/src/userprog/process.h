@@ -4,6 +4,10 @@
 #include "threads/thread.h"
 
 tid_t process_execute (const char *argv);
+#ifdef VM
+struct intr_frame;
+tid_t process_fork (const struct intr_frame *);
+#endif
 int process_wait (tid_t);
 void process_exit (void);
 void process_activate (void);
@@ -1,27 +1,97 @@
 #include "userprog/syscall.h"
 #include <debug.h>
+#include <inttypes.h>
 #include <stdio.h>
 #include <syscall-nr.h>
+#include <syscall-stats.h>
+#include <uio.h>
 #include "threads/interrupt.h"
+#include "threads/malloc.h"
+#include "threads/palloc.h"
 #include "threads/thread.h"
 #include "threads/vaddr.h"
 #include "threads/synch.h"
 #include "userprog/pagedir.h"
+#include "userprog/fdtable.h"
+#include "userprog/gdt.h"
+#include "userprog/pipe.h"
+#include "userprog/poll.h"
 #include "userprog/process.h"
+#include "userprog/tss.h"
+#include "userprog/uaccess.h"
 #include "devices/shutdown.h"
 #include "devices/input.h"
+#include "devices/intq.h"
 #include "filesys/filesys.h"
 #include "filesys/file.h"
+#ifdef VM
+#include "vm/mmap.h"
+#include "vm/page.h"
+#include "vm/shm.h"
+#endif
 
 static void syscall_handler (struct intr_frame *);
 
+/* SYSENTER model-specific registers.  See [IA32-v3a] 4.8.7
+   "Fast System Calls". */
+#define MSR_SYSENTER_CS  0x174  /* Kernel code selector. */
+#define MSR_SYSENTER_ESP 0x175  /* Kernel stack pointer. */
+#define MSR_SYSENTER_EIP 0x176  /* Kernel entry point. */
+
+/* CPUID.1:EDX bit indicating SYSENTER/SYSEXIT support. */
+#define CPUID_SEP 0x00000800
+
+/* True if system calls may enter through SYSENTER. */
+static bool sysenter_enabled;
+
+/* Fast system call entry point, in syscall-entry.S. */
+void syscall_sysenter (void);
+
+/* Writes VALUE to model-specific register MSR. */
+static inline void
+wrmsr (uint32_t msr, uint32_t value)
+{
+  asm volatile ("wrmsr" : : "c" (msr), "a" (value), "d" (0));
+}
+
 void
 syscall_init (void)
 {
+  uint32_t eax = 1, ebx, ecx, edx;
+
   intr_register_int (0x30, 3, INTR_ON, syscall_handler, "syscall");
+
+  /* User programs also check CPUID before using SYSENTER, and
+     fall back to "int $0x30" if it is not available. */
+  asm ("cpuid" : "+a" (eax), "=b" (ebx), "=c" (ecx), "=d" (edx));
+  if (edx & CPUID_SEP)
+    {
+      wrmsr (MSR_SYSENTER_CS, SEL_KCSEG);
+      wrmsr (MSR_SYSENTER_EIP, (uint32_t) syscall_sysenter);
+      sysenter_enabled = true;
+      tss_update ();
+    }
+}
+
+/* Makes SYSENTER switch to kernel stack ESP0, the same one
+   "int $0x30" switches to via the TSS.  Called on every switch
+   to a user process. */
+void
+syscall_set_stack (void *esp0)
+{
+  if (sysenter_enabled)
+    wrmsr (MSR_SYSENTER_ESP, (uint32_t) esp0);
 }
 
 static bool is_valid(uint32_t *pd, void *uaddr) {
+#ifdef VM
+  /* Pages that are not resident yet, or that extend the stack,
+     are faulted in on access. */
+  struct thread *t = thread_current();
+  if (uaddr != NULL && is_user_vaddr(uaddr)
+      && (page_lookup(t, uaddr) != NULL || page_is_stack(uaddr, t->user_esp)))
+    return true;
+#endif
   return uaddr != NULL && is_user_vaddr(uaddr) && pagedir_get_page(pd, uaddr) != NULL;
 }
 
@@ -50,20 +120,556 @@ static void check_valid_uaddr(struct intr_frame *f, void *uaddr, size_t len)
   page_fault_exit(f);
 }
 
-static void validate_char_str(const char* start_addr, struct intr_frame *f) {
-  uint32_t *pd = thread_current()->pagedir;
-  for (;; ++start_addr) {
-    if (!is_valid(pd, (void*)start_addr)) page_fault_exit(f);
-    if (*start_addr == '\0') break;
+// fetches the N syscall arguments above the syscall number into ARGS[1..N].
+static void copy_args(struct intr_frame *f, uint32_t *args, size_t n) {
+  if (copy_from_user(args + 1, (uint32_t*) f->esp + 1, n * sizeof(uint32_t)) != 0)
+    page_fault_exit(f);
+}
+
+// copies the user string USTR into a new page, which the caller must free.
+static char* copy_in_string(struct intr_frame *f, const char* ustr) {
+  char* kstr = palloc_get_page(0);
+  if (kstr == NULL) page_fault_exit(f);
+
+  int len = strncpy_from_user(kstr, ustr, PGSIZE);
+  if (len < 0 || len == PGSIZE) {
+    palloc_free_page(kstr);
+    page_fault_exit(f);
   }
-  return;
+  return kstr;
+}
+
+static void sys_halt(struct intr_frame *f UNUSED, uint32_t *args UNUSED) {
+  shutdown_power_off();
+}
+
+static void sys_exit(struct intr_frame *f UNUSED, uint32_t *args) {
+  printf ("%s: exit(%d)\n", &thread_current ()->name, args[1]);
+  thread_current ()-> exit_status = args[1];
+  thread_exit ();
+}
+
+// waits for the child TID to load, returning TID or TID_ERROR.
+static tid_t wait_for_load(tid_t tid) {
+  if (tid == TID_ERROR) return tid;
+
+  struct thread* t = get_thread(tid);
+  ASSERT(t != NULL);
+
+  sema_down(&(t->load_sem));
+  return t->is_loaded ? tid : TID_ERROR;
+}
+
+static void sys_exec(struct intr_frame *f, uint32_t *args) {
+  char* cmd_line = copy_in_string(f, (char*)args[1]);
+  tid_t tid = process_execute(cmd_line);
+  palloc_free_page(cmd_line);
+  f->eax = wait_for_load(tid);
+}
+
+static void sys_fork(struct intr_frame *f, uint32_t *args UNUSED) {
+  // sharing the address space copy-on-write needs the VM.
+#ifdef VM
+  f->eax = wait_for_load(process_fork(f));
+#else
+  f->eax = TID_ERROR;
+#endif
+}
+
+static void sys_wait(struct intr_frame *f, uint32_t *args) {
+  tid_t tid = args[1];
+  f->eax = process_wait(tid);
+}
+
+static void sys_create(struct intr_frame *f, uint32_t *args) {
+  char* filename = copy_in_string(f, (char*)args[1]);
+  uint32_t init_size = args[2];
+  bool success = filesys_create(filename, init_size);
+  palloc_free_page(filename);
+  f->eax = success;
+}
+
+static void sys_remove(struct intr_frame *f, uint32_t *args) {
+  char* filename = copy_in_string(f, (char*)args[1]);
+  bool success = filesys_remove(filename);
+  palloc_free_page(filename);
+  f->eax = success;
+}
+
+// returns the file open as FD, or NULL if there is none.
+static struct file* fd_lookup(int fd) {
+  return fdtable_get(thread_current()->fdtable, fd);
+}
+
+static void sys_open(struct intr_frame *f, uint32_t *args) {
+  char* filename = copy_in_string(f, (char*)args[1]);
+  struct file* opened_file = filesys_open(filename);
+  if (opened_file == NULL) {
+    palloc_free_page(filename);
+    f->eax = -1;
+    return;
+  }
+
+  // executable running
+  if (get_thread_with_name(filename) != NULL) file_deny_write(opened_file);
+  palloc_free_page(filename);
+
+  // lowest free fd; 0 & 1 are reserved for STDIN & STDOUT.
+  int fd = fdtable_install(thread_current()->fdtable, opened_file);
+
+  // Too many opened files, not enough space.
+  if (fd < 0) file_close(opened_file);
+  f->eax = fd;
+}
+
+static void sys_filesize(struct intr_frame *f, uint32_t *args) {
+  int fd = args[1];
+  struct file* cur_file = fd_lookup(fd);
+  if (cur_file == NULL) {
+    f->eax = 0;
+    return;
+  }
+
+  f->eax = file_length(cur_file);
+}
+
+// reads up to SIZE bytes from pipe P into user BUF.
+static int read_pipe(struct intr_frame *f, struct pipe* p, char* buf, uint32_t size) {
+  // a writer may copy straight into BUF; keep it resident.  pins at
+  // most a ring's worth, since a short read is fine.
+  if (size > PIPE_SIZE) size = PIPE_SIZE;
+#ifdef VM
+  if (!page_pin(buf, size, true)) page_fault_exit(f);
+#else
+  check_valid_uaddr(f, buf, size);
+#endif
+  int read_size = pipe_read(p, buf, size);
+#ifdef VM
+  page_unpin(buf, size);
+#endif
+  return read_size;
+}
+
+// writes SIZE bytes from user BUF to pipe P, a ring's worth at a time.
+static int write_pipe(struct intr_frame *f, struct pipe* p, const char* buf, uint32_t size) {
+  uint32_t written = 0;
+  do {
+    uint32_t chunk = size - written < PIPE_SIZE ? size - written : PIPE_SIZE;
+#ifdef VM
+    if (!page_pin(buf + written, chunk, false)) page_fault_exit(f);
+#else
+    check_valid_uaddr(f, (void*) (buf + written), chunk);
+#endif
+    int n = pipe_write(p, buf + written, chunk);
+#ifdef VM
+    page_unpin(buf + written, chunk);
+#endif
+    // no reader left.
+    if (n < 0) return written > 0 ? (int) written : -1;
+    written += n;
+    if ((uint32_t) n < chunk) break;
+  } while (written < size);
+  return written;
+}
+
+// reads up to SIZE bytes from FD into user BUF, at byte POS of the
+// file or, if POS is -1, at and advancing its current position.
+// returns the number of bytes read, or -1 if FD is not readable.
+static int read_fd(struct intr_frame *f, int fd, char* buf, uint32_t size, off_t pos) {
+  // read from stdin, a line at most, in chunks of whatever is buffered.
+  if (fd == 0 && pos == -1) {
+    uint32_t read_size = 0;
+    while (read_size < size) {
+      uint8_t chunk[INTQ_BUFSIZE];
+      uint32_t want = size - read_size < sizeof chunk ? size - read_size : sizeof chunk;
+      size_t n = input_read(chunk, want, true);
+      if (copy_to_user(buf + read_size, chunk, n) != 0) page_fault_exit(f);
+      read_size += n;
+      if (chunk[n - 1] == '\n') break;
+    }
+    return read_size;
+  }
+
+  // pipes have no position.
+  struct pipe* p = fdtable_get_pipe(thread_current()->fdtable, fd, false);
+  if (p != NULL) return pos == -1 ? read_pipe(f, p, buf, size) : -1;
+
+  struct file* cur_file = fd_lookup(fd);
+  if (cur_file == NULL) return -1;
+
+  off_t start = pos == -1 ? file_tell(cur_file) : pos;
+  off_t length = file_length(cur_file);
+  uint32_t remain_size = start < length ? (uint32_t) (length - start) : 0;
+  uint32_t min_buf_size = remain_size < size ? remain_size : size;
+#ifdef VM
+  // the buffer cache copies into BUF holding a cache entry's lock, so
+  // no page fault may be taken then: paging in from a file could need
+  // that very entry.  keep BUF resident.
+  if (!page_pin(buf, min_buf_size, true)) page_fault_exit(f);
+#else
+  check_valid_uaddr(f, buf, min_buf_size);
+#endif
+  uint32_t read_size = pos == -1
+                       ? file_read(cur_file, buf, min_buf_size)
+                       : file_read_at(cur_file, buf, min_buf_size, pos);
+#ifdef VM
+  page_unpin(buf, min_buf_size);
+#endif
+  // a process sharing the file by fork() may have moved its position
+  // since START was taken, so this can be short of MIN_BUF_SIZE.
+  return read_size;
+}
+
+// writes up to SIZE bytes from user BUF to FD, at byte POS of the
+// file or, if POS is -1, at and advancing its current position.
+// returns the number of bytes written, or -1 if FD is not writable.
+static int write_fd(struct intr_frame *f, int fd, const char* buf, uint32_t size, off_t pos) {
+  // write to stdout
+  if (fd == 1 && pos == -1) {
+    check_valid_uaddr(f, (void*) buf, size);
+    putbuf(buf, size);
+    return size;
+  }
+
+  // pipes have no position.
+  struct pipe* p = fdtable_get_pipe(thread_current()->fdtable, fd, true);
+  if (p != NULL) return pos == -1 ? write_pipe(f, p, buf, size) : -1;
+
+  struct file* cur_file = fd_lookup(fd);
+  if (cur_file == NULL) return -1;
+
+  // writing past the end grows the file.
+#ifdef VM
+  // the buffer cache copies out of BUF holding a cache entry's lock, so
+  // no page fault may be taken then.  keep BUF resident.
+  if (!page_pin(buf, size, false)) page_fault_exit(f);
+#else
+  check_valid_uaddr(f, (void*) buf, size);
+#endif
+  uint32_t write_size = pos == -1
+                        ? file_write(cur_file, buf, size)
+                        : file_write_at(cur_file, buf, size, pos);
+#ifdef VM
+  page_unpin(buf, size);
+#endif
+  return write_size;
+}
+
+// copies in the user iovec array IOV of IOVCNT entries to KIOV.
+// returns false if IOVCNT is out of range.
+static bool copy_in_iovec(struct intr_frame *f, struct iovec* kiov,
+                          const struct iovec* iov, int iovcnt) {
+  if (iovcnt < 0 || iovcnt > IOV_MAX) return false;
+  if (copy_from_user(kiov, iov, iovcnt * sizeof *kiov) != 0) page_fault_exit(f);
+  return true;
+}
+
+static void sys_read(struct intr_frame *f, uint32_t *args) {
+  f->eax = read_fd(f, args[1], (char*) args[2], args[3], -1);
+}
+
+static void sys_write(struct intr_frame *f, uint32_t *args) {
+  int write_size = write_fd(f, args[1], (char*) args[2], args[3], -1);
+  f->eax = write_size < 0 ? 0 : write_size;
+}
+
+static void sys_pread(struct intr_frame *f, uint32_t *args) {
+  off_t pos = args[4];
+  f->eax = pos < 0 ? -1 : read_fd(f, args[1], (char*) args[2], args[3], pos);
+}
+
+static void sys_pwrite(struct intr_frame *f, uint32_t *args) {
+  off_t pos = args[4];
+  f->eax = pos < 0 ? -1 : write_fd(f, args[1], (char*) args[2], args[3], pos);
+}
+
+static void sys_readv(struct intr_frame *f, uint32_t *args) {
+  struct iovec iov[IOV_MAX];
+  int iovcnt = args[3];
+  if (!copy_in_iovec(f, iov, (struct iovec*) args[2], iovcnt)) {
+    f->eax = -1;
+    return;
+  }
+
+  // stops early at end of file, like a short read().
+  int total = 0;
+  int i;
+  for (i = 0; i < iovcnt; i++) {
+    int n = read_fd(f, args[1], iov[i].iov_base, iov[i].iov_len, -1);
+    if (n < 0) {
+      f->eax = -1;
+      return;
+    }
+    total += n;
+    if ((size_t) n < iov[i].iov_len) break;
+  }
+  f->eax = total;
+}
+
+static void sys_writev(struct intr_frame *f, uint32_t *args) {
+  struct iovec iov[IOV_MAX];
+  int iovcnt = args[3];
+  if (!copy_in_iovec(f, iov, (struct iovec*) args[2], iovcnt)) {
+    f->eax = -1;
+    return;
+  }
+
+  // stops early at end of file, like a short write().
+  int total = 0;
+  int i;
+  for (i = 0; i < iovcnt; i++) {
+    int n = write_fd(f, args[1], iov[i].iov_base, iov[i].iov_len, -1);
+    if (n < 0) {
+      f->eax = -1;
+      return;
+    }
+    total += n;
+    if ((size_t) n < iov[i].iov_len) break;
+  }
+  f->eax = total;
+}
+
+static void sys_copy_file_range(struct intr_frame *f, uint32_t *args) {
+  struct file* in = fd_lookup(args[1]);
+  struct file* out = fd_lookup(args[2]);
+  off_t len = args[3];
+  // copying within one file could overlap itself.
+  if (in == NULL || out == NULL || len < 0
+      || file_get_inode(in) == file_get_inode(out)) {
+    f->eax = -1;
+    return;
+  }
+
+  f->eax = file_copy(out, in, len);
+}
+
+static void sys_seek(struct intr_frame *f UNUSED, uint32_t *args) {
+  int fd = args[1];
+  uint32_t pos = args[2];
+
+  struct file* cur_file = fd_lookup(fd);
+  if (cur_file == NULL) {
+    return;
+  }
+
+  file_seek(cur_file, pos);
+}
+
+static void sys_tell(struct intr_frame *f, uint32_t *args) {
+  int fd = args[1];
+  struct file* cur_file = fd_lookup(fd);
+  if (cur_file == NULL) {
+    f->eax = 0;
+    return;
+  }
+
+  f->eax = file_tell(cur_file);
+}
+
+static void sys_close(struct intr_frame *f UNUSED, uint32_t *args) {
+  int fd = args[1];
+  fdtable_close(thread_current()->fdtable, fd);
+}
+
+// writes the data of file ARGS[1] to disk. returns 0, or -1 for a bad fd.
+static void sys_fsync(struct intr_frame *f, uint32_t *args) {
+  struct file* cur_file = fd_lookup(args[1]);
+  if (cur_file == NULL) {
+    f->eax = -1;
+    return;
+  }
+
+  file_sync(cur_file);
+  f->eax = 0;
+}
+
+// creates a pipe, storing its read and write fds in user array ARGS[1].
+static void sys_pipe(struct intr_frame *f, uint32_t *args) {
+  struct fdtable* fdt = thread_current()->fdtable;
+  struct pipe* p = pipe_create();
+  if (p == NULL) {
+    f->eax = -1;
+    return;
+  }
+
+  int fds[2];
+  fds[0] = fdtable_install_pipe(fdt, p, false);
+  if (fds[0] < 0) {
+    pipe_close(p, false);
+    pipe_close(p, true);
+    f->eax = -1;
+    return;
+  }
+  fds[1] = fdtable_install_pipe(fdt, p, true);
+  if (fds[1] < 0) {
+    fdtable_close(fdt, fds[0]);
+    pipe_close(p, true);
+    f->eax = -1;
+    return;
+  }
+
+  if (copy_to_user((void*) args[1], fds, sizeof fds) != 0) page_fault_exit(f);
+  f->eax = 0;
+}
+
+static void sys_practice(struct intr_frame *f, uint32_t *args) {
+  f->eax = args[1] + 1;
+}
+
+#ifdef VM
+static void sys_mmap(struct intr_frame *f, uint32_t *args) {
+  int fd = args[1];
+  void* addr = (void*) args[2];
+  // stdin and stdout have no file, so cannot be mapped.
+  struct file* cur_file = fd_lookup(fd);
+  if (cur_file == NULL) {
+    f->eax = MAP_FAILED;
+    return;
+  }
+
+  f->eax = mmap_map(cur_file, addr);
+}
+
+static void sys_munmap(struct intr_frame *f UNUSED, uint32_t *args) {
+  mmap_unmap((mapid_t) args[1]);
+}
+
+static void sys_shm_create(struct intr_frame *f, uint32_t *args) {
+  f->eax = shm_create(args[1], args[2]);
+}
+
+static void sys_shm_attach(struct intr_frame *f, uint32_t *args) {
+  f->eax = (uint32_t) shm_attach((shmid_t) args[1], (void*) args[2]);
+}
+
+static void sys_shm_detach(struct intr_frame *f, uint32_t *args) {
+  f->eax = shm_detach((void*) args[1]);
+}
+#endif
+
+static void sys_syscall_stats(struct intr_frame *f, uint32_t *args);
+
+// waits for events on the ARGS[2] fds in user array ARGS[1], for at
+// most ARGS[3] milliseconds.
+static void sys_poll(struct intr_frame *f, uint32_t *args) {
+  struct pollfd* ufds = (struct pollfd*) args[1];
+  uint32_t nfds = args[2];
+  int timeout = args[3];
+  if (nfds > FD_MAX) {
+    f->eax = -1;
+    return;
+  }
+
+  struct pollfd* fds = malloc(nfds * sizeof *fds);
+  if (fds == NULL && nfds > 0) {
+    f->eax = -1;
+    return;
+  }
+  if (copy_from_user(fds, ufds, nfds * sizeof *fds) != 0) {
+    free(fds);
+    page_fault_exit(f);
+  }
+
+  int ready = poll_fds(fds, nfds, timeout);
+  if (ready >= 0 && copy_to_user(ufds, fds, nfds * sizeof *fds) != 0) {
+    free(fds);
+    page_fault_exit(f);
+  }
+  free(fds);
+  f->eax = ready;
+}
+
+/* A system call, given the interrupt frame and its arguments in
+   ARGS[1] through ARGS[ARG_CNT]. */
+typedef void syscall_func (struct intr_frame *, uint32_t *args);
+
+/* System call table entry. */
+struct syscall
+  {
+    syscall_func *func;         /* Handler, or NULL if not implemented. */
+    size_t arg_cnt;             /* Number of arguments, at most 4. */
+    const char *name;           /* Name, for statistics. */
+  };
+
+/* System calls, indexed by SYS_* number. */
+static const struct syscall syscalls[] =
+  {
+    [SYS_HALT] = {sys_halt, 0, "halt"},
+    [SYS_EXIT] = {sys_exit, 1, "exit"},
+    [SYS_EXEC] = {sys_exec, 1, "exec"},
+    [SYS_WAIT] = {sys_wait, 1, "wait"},
+    [SYS_CREATE] = {sys_create, 2, "create"},
+    [SYS_REMOVE] = {sys_remove, 1, "remove"},
+    [SYS_OPEN] = {sys_open, 1, "open"},
+    [SYS_FILESIZE] = {sys_filesize, 1, "filesize"},
+    [SYS_READ] = {sys_read, 3, "read"},
+    [SYS_WRITE] = {sys_write, 3, "write"},
+    [SYS_SEEK] = {sys_seek, 2, "seek"},
+    [SYS_TELL] = {sys_tell, 1, "tell"},
+    [SYS_CLOSE] = {sys_close, 1, "close"},
+    [SYS_PRACTICE] = {sys_practice, 1, "practice"},
+#ifdef VM
+    [SYS_MMAP] = {sys_mmap, 2, "mmap"},
+    [SYS_MUNMAP] = {sys_munmap, 1, "munmap"},
+    [SYS_SHM_CREATE] = {sys_shm_create, 2, "shm_create"},
+    [SYS_SHM_ATTACH] = {sys_shm_attach, 2, "shm_attach"},
+    [SYS_SHM_DETACH] = {sys_shm_detach, 1, "shm_detach"},
+#endif
+    [SYS_FORK] = {sys_fork, 0, "fork"},
+    [SYS_SYSCALL_STATS] = {sys_syscall_stats, 2, "syscall_stats"},
+    [SYS_PREAD] = {sys_pread, 4, "pread"},
+    [SYS_PWRITE] = {sys_pwrite, 4, "pwrite"},
+    [SYS_READV] = {sys_readv, 3, "readv"},
+    [SYS_WRITEV] = {sys_writev, 3, "writev"},
+    [SYS_COPY_FILE_RANGE] = {sys_copy_file_range, 3, "copy_file_range"},
+    [SYS_PIPE] = {sys_pipe, 1, "pipe"},
+    [SYS_POLL] = {sys_poll, 3, "poll"},
+    [SYS_FSYNC] = {sys_fsync, 1, "fsync"},
+  };
+
+/* Number of entries in syscalls[]. */
+#define SYSCALL_CNT (sizeof syscalls / sizeof *syscalls)
+
+/* Call counts and latencies, indexed by SYS_* number. */
+static struct syscall_stats stats[SYSCALL_CNT];
+
+/* Returns the current value of the CPU's time-stamp counter. */
+static inline uint64_t
+rdtsc (void)
+{
+  uint64_t tsc;
+  asm volatile ("rdtsc" : "=A" (tsc));
+  return tsc;
+}
+
+/* Records that system call NUMBER took CYCLES cycles. */
+static void
+record_latency (unsigned number, uint64_t cycles)
+{
+  struct syscall_stats *s = &stats[number];
+  enum intr_level old_level;
+  int bucket = 0;
+
+  while (bucket < SYSCALL_HIST_CNT - 1
+         && cycles >> (bucket + SYSCALL_HIST_SHIFT + 1) != 0)
+    bucket++;
+
+  old_level = intr_disable ();
+  s->cycles += cycles;
+  s->hist[bucket]++;
+  intr_set_level (old_level);
 }
 
 static void
-syscall_handler (struct intr_frame *f UNUSED)
+syscall_handler (struct intr_frame *f)
 {
-  check_valid_uaddr (f, f->esp, sizeof(uint32_t));
-  uint32_t* args = ((uint32_t*) f->esp);
+#ifdef VM
+  // kernel page faults on user memory grow the stack relative to this.
+  thread_current()->user_esp = f->esp;
+#endif
+  // user memory is read directly; a bad pointer faults into the fixup.
+  uint32_t args[5];
+  if (copy_from_user(args, f->esp, sizeof(uint32_t)) != 0) page_fault_exit(f);
 
   /*
    * The following print statement, if uncommented, will print out the syscall
@@ -74,245 +680,62 @@ syscall_handler (struct intr_frame *f UNUSED)
 
    // printf("System call number: %d\n", args[0]); 
 
-  switch(args[0]) 
+  unsigned number = args[0];
+  if (number >= SYSCALL_CNT || syscalls[number].func == NULL) {
+    f->eax = -1;
+    return;
+  }
+
+  // every argument is fetched here, once, so handlers just use ARGS.
+  const struct syscall *sc = &syscalls[number];
+  copy_args(f, args, sc->arg_cnt);
+
+  // counted on entry, since exit never returns.
+  enum intr_level old_level = intr_disable();
+  stats[number].count++;
+  intr_set_level(old_level);
+
+  uint64_t start = rdtsc();
+  sc->func(f, args);
+  record_latency(number, rdtsc() - start);
+}
+
+// copies the statistics for syscall ARGS[1] to the user buffer ARGS[2].
+static void sys_syscall_stats(struct intr_frame *f, uint32_t *args) {
+  unsigned number = args[1];
+  if (number >= SYSCALL_CNT || syscalls[number].func == NULL) {
+    f->eax = -1;
+    return;
+  }
+
+  struct syscall_stats s;
+  enum intr_level old_level = intr_disable();
+  s = stats[number];
+  intr_set_level(old_level);
+
+  if (copy_to_user((void*) args[2], &s, sizeof s) != 0) page_fault_exit(f);
+  f->eax = 0;
+}
+
+/* Prints system call statistics. */
+void
+syscall_print_stats (void)
+{
+  size_t i;
+  int j;
+
+  printf ("System calls:\n");
+  for (i = 0; i < SYSCALL_CNT; i++)
     {
-      case SYS_EXIT:
-        check_valid_uaddr(f, args + 1, sizeof(uint32_t));
-        printf ("%s: exit(%d)\n", &thread_current ()->name, args[1]);
-        thread_current ()-> exit_status = args[1];
-        thread_exit ();
-        break;
-
-      case SYS_PRACTICE:
-        check_valid_uaddr(f, args + 1, sizeof(uint32_t));
-        f->eax = args[1] + 1; 
-        break;
-
-      case SYS_WRITE:
-        { 
-          check_valid_uaddr(f, args + 1, 3 * sizeof(uint32_t));
-          int fd = args[1];
-          char* buf = (char*) args[2];
-          uint32_t size = args[3];
-          if (fd < 0 || fd >= MAX_FILE_DESCRIPTORS) {
-            f->eax = 0;
-            break;
-          }
-
-          // write to stdout
-          if (fd == 1) {
-            check_valid_uaddr(f, buf, size);
-            putbuf(buf, size);
-            f->eax = size;
-            break;
-          }
-
-          struct file* cur_file = thread_current()->fdtable[fd];
-          if (cur_file == NULL) {
-            f->eax = 0;
-            break;
-          }
-
-          uint32_t remain_size = file_length(cur_file) - file_tell(cur_file);
-          uint32_t max_write_size = remain_size < size ? remain_size : size;
-          check_valid_uaddr(f, buf, max_write_size);
-
-          uint32_t write_size = file_write(cur_file, buf, size);
-          f->eax = write_size;
-          break;
-        }
-      case SYS_HALT:
-        shutdown_power_off();
-        break;
-
-      case SYS_EXEC:
-        {
-          check_valid_uaddr(f, args + 1, sizeof(uint32_t));
-          char* start_addr = (char*)args[1];
-          validate_char_str(start_addr, f);
-
-          tid_t tid = process_execute(start_addr);
-          if (tid == TID_ERROR) {
-            f->eax = tid;
-            break;
-          }
-
-          struct thread* t = get_thread(tid);
-          ASSERT(t != NULL);
-
-          sema_down(&(t->load_sem));
-          if (t->is_loaded) {
-            f->eax = tid;
-          } else {
-            f->eax = TID_ERROR;
-          }
-          break;
-        }
-
-      case SYS_WAIT:
-        {
-          check_valid_uaddr(f, args + 1, sizeof(uint32_t));
-          tid_t tid = args[1];
-          f->eax = process_wait(tid); 
-          break;
-        } 
-
-      case SYS_CREATE:
-        {
-          check_valid_uaddr(f, args + 1, 2 * sizeof(uint32_t));
-          char* filename = (char*)args[1];
-          validate_char_str(filename, f);
-          uint32_t init_size = args[2];
-          bool success = filesys_create(filename, init_size);
-          f->eax = success;
-          break;
-        }
-
-      case SYS_REMOVE:
-        {
-          check_valid_uaddr(f, args + 1, sizeof(uint32_t));
-          char* filename = (char*)args[1];
-          validate_char_str(filename, f);
-          bool success = filesys_remove(filename);
-          f->eax = success;
-          break;
-        }      
-
-      case SYS_OPEN:
-        {
-          check_valid_uaddr(f, args + 1, sizeof(uint32_t));
-          char* filename = (char*)args[1];
-          validate_char_str(filename, f);
-          struct file* opened_file = filesys_open(filename);
-          if (opened_file == NULL) {
-            f->eax = -1;
-            break;
-          }
-
-          // executable running
-          if (get_thread_with_name(filename) != NULL) file_deny_write(opened_file);
-
-          struct file** cur_fdtable = thread_current()->fdtable; 
-          int i;
-
-          // fd 0 & 1 reserved for STDIN & STDOUT.
-          for (i = 2; i < MAX_FILE_DESCRIPTORS; ++i) {
-            if (cur_fdtable[i] == NULL) {
-              cur_fdtable[i] = opened_file;
-              f->eax = i;
-              break;
-            }
-          }
-
-          // Too many opened files, not enough space.
-          if (i == MAX_FILE_DESCRIPTORS) f->eax = -1;
-          break;
-        }
-
-      case SYS_CLOSE:
-        {
-          check_valid_uaddr(f, args + 1, sizeof(uint32_t));
-          int fd = args[1];
-          if (fd < 0 || fd >= MAX_FILE_DESCRIPTORS) break;
-
-          struct file** cur_fdtable = thread_current()->fdtable;
-          file_close(cur_fdtable[fd]);
-          cur_fdtable[fd] = NULL;
-          break;
-        }
-
-      case SYS_FILESIZE:
-        {
-          check_valid_uaddr(f, args + 1, sizeof(uint32_t));
-          int fd = args[1];
-          if (fd < 0 || fd >= MAX_FILE_DESCRIPTORS) {
-            f->eax = 0;
-            break;
-          }
-
-          struct file* cur_file = thread_current()->fdtable[fd];
-          if (cur_file == NULL) {
-            f->eax = 0;
-            break;
-          }
-
-          f->eax = file_length(cur_file);
-          break;
-        }
-
-      case SYS_TELL:
-        {
-          check_valid_uaddr(f, args + 1, sizeof(uint32_t));
-          int fd = args[1];
-          if (fd < 0 || fd >= MAX_FILE_DESCRIPTORS) {
-            f->eax = 0;
-            break;
-          }
-
-          struct file* cur_file = thread_current()->fdtable[fd];
-          if (cur_file == NULL) {
-            f->eax = 0;
-            break;
-          }
-
-          f->eax = file_tell(cur_file);
-          break;
-        }
-      case SYS_SEEK:
-        {
-          check_valid_uaddr(f, args + 1, 2 * sizeof(uint32_t));
-          int fd = args[1];
-          if (fd < 0 || fd >= MAX_FILE_DESCRIPTORS) {
-            break;
-          }
-          uint32_t pos = args[2];
-
-          struct file* cur_file = thread_current()->fdtable[fd];
-          if (cur_file == NULL) {
-            break;
-          }
-
-          file_seek(cur_file, pos);
-          break;          
-        }
-
-      case SYS_READ:
-        {
-          check_valid_uaddr(f, args + 1, 3 * sizeof(uint32_t));
-          int fd = args[1];
-          char* buf = (char*) args[2];
-          uint32_t size = args[3];
-          if (fd < 0 || fd >= MAX_FILE_DESCRIPTORS) {
-            f->eax = -1;
-            break;
-          }
-
-          // read from stdin
-          if (fd == 0) {
-            check_valid_uaddr(f, buf, size);
-            while (size > 0) {
-              *buf = input_getc();
-              buf++;
-              size--;
-            }
-            f->eax = size;
-            break;
-          }
-
-          struct file* cur_file = thread_current()->fdtable[fd];
-          if (cur_file == NULL) {
-            f->eax = -1;
-            break;
-          }
-
-          uint32_t remain_size = file_length(cur_file) - file_tell(cur_file);
-          uint32_t min_buf_size = remain_size < size ? remain_size : size;
-          check_valid_uaddr(f, buf, min_buf_size);
-
-          uint32_t read_size = file_read(cur_file, buf, size);
-          ASSERT(read_size == min_buf_size);
-          f->eax = read_size;
-          break;
-        }
+      const struct syscall_stats *s = &stats[i];
+
+      if (s->count == 0)
+        continue;
+      printf ("  %-15s %8"PRIu64" calls %10"PRIu64" cycles avg  ",
+              syscalls[i].name, s->count, s->cycles / s->count);
+      for (j = 0; j < SYSCALL_HIST_CNT; j++)
+        if (s->hist[j] != 0)
+          printf (" %d:%"PRIu32, j + SYSCALL_HIST_SHIFT, s->hist[j]);
+      printf ("\n");
     }
 }
@@ -2,5 +2,7 @@
 #define USERPROG_SYSCALL_H
 
 void syscall_init (void);
+void syscall_set_stack (void *esp0);
+void syscall_print_stats (void);
 
 #endif /* userprog/syscall.h */
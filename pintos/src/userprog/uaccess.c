@@ -0,0 +1,144 @@
+#include "userprog/uaccess.h"
+#include <stdint.h>
+#include "threads/interrupt.h"
+#include "threads/vaddr.h"
+
+/* Access to user memory.
+
+   Rather than checking that every page of a user buffer is
+   mapped before touching it, the functions here access user
+   memory directly.  Each instruction that may fault on a user
+   address is recorded in the exception table, together with the
+   address at which to continue if it does.  When a page fault in
+   the kernel cannot be resolved, page_fault() calls
+   uaccess_fixup(), which resumes execution at the fixup address
+   instead of panicking, and the function then reports the
+   failure to its caller.  The common case, where the memory is
+   valid, costs no more than an ordinary memory access.
+
+   Only addresses below PHYS_BASE are ever accessed this way,
+   since kernel addresses are always mapped and would not
+   fault. */
+
+/* An exception table entry. */
+struct ex_entry
+  {
+    uintptr_t insn;             /* Instruction that may fault. */
+    uintptr_t fixup;            /* Where to continue if it does. */
+  };
+
+/* Exception table, collected from the `.ex_table' sections of
+   all object files by the linker script. */
+extern const struct ex_entry _start_ex_table[], _end_ex_table[];
+
+/* Assembler directives that add an exception table entry for the
+   instruction at local label INSN, continuing at local label
+   FIXUP. */
+#define EX_TABLE(INSN, FIXUP)                                   \
+        ".section .ex_table, \"a\"\n\t"                         \
+        ".long " #INSN ", " #FIXUP "\n\t"                       \
+        ".previous\n"
+
+/* Returns true if the SIZE bytes starting at UADDR all lie below
+   PHYS_BASE. */
+static bool
+is_user_range (const void *uaddr, size_t size)
+{
+  return ((uintptr_t) uaddr <= (uintptr_t) PHYS_BASE
+          && size <= (uintptr_t) PHYS_BASE - (uintptr_t) uaddr);
+}
+
+/* Copies SIZE bytes from user address USRC to kernel address
+   DST.  Returns the number of bytes that could not be copied,
+   which is 0 on success. */
+size_t
+copy_from_user (void *dst, const void *usrc, size_t size)
+{
+  if (!is_user_range (usrc, size))
+    return size;
+
+  /* A fault leaves ECX holding the number of bytes not yet
+     copied. */
+  asm volatile ("1: rep movsb\n"
+                "2:\n"
+                EX_TABLE (1b, 2b)
+                : "+c" (size), "+S" (usrc), "+D" (dst) : : "memory");
+  return size;
+}
+
+/* Copies SIZE bytes from kernel address SRC to user address
+   UDST.  Returns the number of bytes that could not be copied,
+   which is 0 on success. */
+size_t
+copy_to_user (void *udst, const void *src, size_t size)
+{
+  if (!is_user_range (udst, size))
+    return size;
+
+  asm volatile ("1: rep movsb\n"
+                "2:\n"
+                EX_TABLE (1b, 2b)
+                : "+c" (size), "+S" (src), "+D" (udst) : : "memory");
+  return size;
+}
+
+/* Reads a byte at user address UADDR, which must be below
+   PHYS_BASE.  Returns the byte value if successful, -1 if a
+   fault occurred. */
+static inline int
+get_user (const uint8_t *uaddr)
+{
+  int result = -1;
+
+  /* A fault skips the load, leaving RESULT at -1. */
+  asm volatile ("1: movzbl %1, %0\n"
+                "2:\n"
+                EX_TABLE (1b, 2b)
+                : "+r" (result) : "m" (*uaddr));
+  return result;
+}
+
+/* Copies the null-terminated string at user address USRC into
+   DST, which has room for SIZE bytes.  Returns the length of the
+   string, not counting the null terminator.  Returns SIZE if no
+   null terminator was found in the first SIZE bytes, in which
+   case DST is not null-terminated.  Returns -1 if part of the
+   string is not mapped or it runs into kernel memory. */
+int
+strncpy_from_user (char *dst, const char *usrc, size_t size)
+{
+  const uint8_t *src = (const uint8_t *) usrc;
+  size_t len;
+
+  for (len = 0; len < size; len++)
+    {
+      int c;
+
+      if ((uintptr_t) (src + len) >= (uintptr_t) PHYS_BASE)
+        return -1;
+      c = get_user (src + len);
+      if (c < 0)
+        return -1;
+      dst[len] = c;
+      if (c == '\0')
+        return len;
+    }
+  return size;
+}
+
+/* If the kernel instruction that raised exception F is listed
+   in the exception table, arranges for F to resume at its fixup
+   address and returns true.  Returns false otherwise. */
+bool
+uaccess_fixup (struct intr_frame *f)
+{
+  const struct ex_entry *e;
+
+  for (e = _start_ex_table; e < _end_ex_table; e++)
+    if (e->insn == (uintptr_t) f->eip)
+      {
+        f->eip = (void (*) (void)) e->fixup;
+        return true;
+      }
+  return false;
+}
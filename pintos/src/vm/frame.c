@@ -0,0 +1,551 @@
+#include "vm/frame.h"
+#include <debug.h>
+#include <stdint.h>
+#include "filesys/inode.h"
+#include "threads/malloc.h"
+#include "threads/palloc.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "userprog/pagedir.h"
+#include "vm/page.h"
+#include "vm/swap.h"
+
+/* Frame table.  Every frame in the user pool that currently
+   holds a user page is on FRAME_TABLE, in allocation order.
+   Victims are chosen with the clock algorithm.
+
+   Eviction works in clusters: rather than writing a single
+   victim to swap each time a frame is needed, up to
+   SWAP_CLUSTER_PAGES victims are collected in one sweep of the
+   clock hand, sorted by process and address, and written to a
+   run of consecutive swap slots in one disk request.  The frames
+   left over are returned to the user pool for the next
+   allocations. */
+static struct list frame_table;
+
+/* Next frame the clock hand will examine. */
+static struct list_elem *clock_hand;
+
+/* Shared file frames, keyed by inode and offset, so that every
+   mapping of a file region uses the same frame. */
+static struct hash shared_frames;
+
+/* Serializes the frame table and every transition of a page in
+   or out of a frame.  It is dropped while a shared file frame is
+   written back (see frame_retire()), so functions that allocate
+   or release frames may return having released it for a while. */
+static struct lock frame_lock;
+
+static hash_hash_func shared_hash;
+static hash_less_func shared_less;
+static void frame_detach (struct frame *);
+static bool frame_retire (struct frame *);
+static void frame_free (struct frame *);
+static bool evict_cluster (void);
+
+/* Initializes the frame table. */
+void
+frame_init (void)
+{
+  list_init (&frame_table);
+  if (!hash_init (&shared_frames, shared_hash, shared_less, NULL))
+    PANIC ("shared frame table creation failed");
+  lock_init (&frame_lock);
+  clock_hand = NULL;
+}
+
+/* Acquires the frame table lock. */
+void
+frame_lock_acquire (void)
+{
+  lock_acquire (&frame_lock);
+}
+
+/* Releases the frame table lock. */
+void
+frame_lock_release (void)
+{
+  lock_release (&frame_lock);
+}
+
+/* Adds a frame for KPAGE, holding PAGE, to the frame table.
+   Returns the new frame, or a null pointer (freeing KPAGE) if
+   memory allocation fails. */
+static struct frame *
+register_frame (void *kpage, struct page *page)
+{
+  struct frame *f = malloc (sizeof *f);
+  if (f == NULL)
+    {
+      palloc_free_page (kpage);
+      return NULL;
+    }
+  f->kpage = kpage;
+  list_init (&f->pages);
+  f->pin_cnt = 0;
+  f->dirty = false;
+  f->inode = NULL;
+  list_push_back (&frame_table, &f->elem);
+  frame_attach (f, page);
+  return f;
+}
+
+/* Allocates a frame for PAGE without evicting anything.
+   Returns a null pointer if the user pool is exhausted.
+   The frame table lock must be held. */
+struct frame *
+frame_try_alloc (struct page *page)
+{
+  void *kpage;
+
+  ASSERT (lock_held_by_current_thread (&frame_lock));
+
+  kpage = palloc_get_page (PAL_USER);
+  return kpage != NULL ? register_frame (kpage, page) : NULL;
+}
+
+/* Allocates a frame for PAGE, evicting other pages if the user
+   pool is exhausted.  Returns a null pointer if no frame could
+   be freed.  The frame table lock must be held. */
+struct frame *
+frame_alloc (struct page *page)
+{
+  void *kpage;
+
+  ASSERT (lock_held_by_current_thread (&frame_lock));
+
+  kpage = palloc_get_page (PAL_USER);
+  while (kpage == NULL && evict_cluster ())
+    kpage = palloc_get_page (PAL_USER);
+  return kpage != NULL ? register_frame (kpage, page) : NULL;
+}
+
+/* Allocates PAGE_CNT contiguous pages from the user pool for use
+   outside the frame table, evicting other pages if the pool is
+   exhausted.  Returns a null pointer if not enough memory could
+   be freed.  The frame table lock must be held. */
+void *
+frame_alloc_kpages (size_t page_cnt)
+{
+  void *kpages;
+
+  ASSERT (lock_held_by_current_thread (&frame_lock));
+
+  kpages = palloc_get_multiple (PAL_USER | PAL_ZERO, page_cnt);
+  while (kpages == NULL && evict_cluster ())
+    kpages = palloc_get_multiple (PAL_USER | PAL_ZERO, page_cnt);
+  return kpages;
+}
+
+/* Records that PAGE is held in frame F.  The caller maps it. */
+void
+frame_attach (struct frame *f, struct page *page)
+{
+  ASSERT (page->frame == NULL);
+
+  list_push_back (&f->pages, &page->frame_elem);
+  page->frame = f;
+}
+
+/* Unmaps PAGE from its frame.  Once no page maps the frame any
+   more and it is not pinned, it is freed, after writing its
+   contents back if it is a modified shared file frame.  The
+   frame table lock must be held, and is released during the
+   write. */
+void
+frame_release (struct page *page)
+{
+  struct frame *f = page->frame;
+  uint32_t *pd = page->owner->pagedir;
+
+  ASSERT (lock_held_by_current_thread (&frame_lock));
+  ASSERT (f != NULL);
+
+  pagedir_clear_page (pd, page->upage);
+  if (pagedir_is_dirty (pd, page->upage))
+    f->dirty = true;
+  list_remove (&page->frame_elem);
+  page->frame = NULL;
+
+  if (list_empty (&f->pages) && f->pin_cnt == 0)
+    frame_retire (f);
+}
+
+/* Frees F, which no page maps any more and which is not pinned,
+   first writing it back to its file if it is a modified shared
+   file frame.  Returns true if F was freed, false if it gained a
+   new mapping while it was written back.
+
+   The write may have to wait for the disk and for the journal,
+   so it is done without the frame table lock.  Meanwhile F stays
+   pinned, and in the shared frame table, so that a new mapping
+   of the region picks up the data being written instead of
+   reading stale data from the file. */
+static bool
+frame_retire (struct frame *f)
+{
+  struct inode *inode;
+  bool freed = false;
+
+  ASSERT (lock_held_by_current_thread (&frame_lock));
+  ASSERT (list_empty (&f->pages) && f->pin_cnt == 0);
+
+  if (f->inode == NULL || !f->dirty)
+    {
+      frame_free (f);
+      return true;
+    }
+
+  /* The last mapping may close the file meanwhile. */
+  inode = inode_reopen (f->inode);
+  f->pin_cnt++;
+  while (f->dirty && list_empty (&f->pages) && f->pin_cnt == 1)
+    {
+      f->dirty = false;
+      lock_release (&frame_lock);
+      inode_write_at (inode, f->kpage, f->write_bytes, f->ofs);
+      lock_acquire (&frame_lock);
+    }
+  f->pin_cnt--;
+  if (list_empty (&f->pages) && f->pin_cnt == 0)
+    {
+      frame_free (f);
+      freed = true;
+    }
+
+  lock_release (&frame_lock);
+  inode_close (inode);
+  lock_acquire (&frame_lock);
+  return freed;
+}
+
+/* Removes F from the frame table, detaching any pages still
+   recorded in it, and returns its memory to the user pool.  The
+   pages must already have been unmapped. */
+static void
+frame_free (struct frame *f)
+{
+  ASSERT (f->pin_cnt == 0);
+
+  frame_detach (f);
+  if (f->inode != NULL)
+    hash_delete (&shared_frames, &f->hash_elem);
+  if (clock_hand == &f->elem)
+    clock_hand = list_next (clock_hand);
+  list_remove (&f->elem);
+  palloc_free_page (f->kpage);
+  free (f);
+}
+
+/* Detaches every page recorded in F, which must already have
+   been unmapped. */
+static void
+frame_detach (struct frame *f)
+{
+  while (!list_empty (&f->pages))
+    {
+      struct page *p = list_entry (list_pop_front (&f->pages),
+                                   struct page, frame_elem);
+      p->frame = NULL;
+    }
+}
+
+/* Returns the shared frame holding INODE's data at offset OFS,
+   or a null pointer if there is none.  The frame table lock must
+   be held. */
+struct frame *
+frame_lookup_shared (struct inode *inode, off_t ofs)
+{
+  struct frame f;
+  struct hash_elem *e;
+
+  ASSERT (lock_held_by_current_thread (&frame_lock));
+
+  f.inode = inode;
+  f.ofs = ofs;
+  e = hash_find (&shared_frames, &f.hash_elem);
+  return e != NULL ? hash_entry (e, struct frame, hash_elem) : NULL;
+}
+
+/* Makes F the shared frame for WRITE_BYTES bytes of INODE at
+   offset OFS, which it must already contain.  The frame table
+   lock must be held. */
+void
+frame_share (struct frame *f, struct inode *inode, off_t ofs,
+             size_t write_bytes)
+{
+  ASSERT (lock_held_by_current_thread (&frame_lock));
+  ASSERT (f->inode == NULL);
+
+  f->inode = inode;
+  f->ofs = ofs;
+  f->write_bytes = write_bytes;
+  hash_insert (&shared_frames, &f->hash_elem);
+}
+
+/* Returns a hash value for shared frame F. */
+static unsigned
+shared_hash (const struct hash_elem *f_, void *aux UNUSED)
+{
+  const struct frame *f = hash_entry (f_, struct frame, hash_elem);
+  return hash_bytes (&f->inode, sizeof f->inode) ^ hash_int (f->ofs);
+}
+
+/* Returns true if shared frame A precedes shared frame B. */
+static bool
+shared_less (const struct hash_elem *a_, const struct hash_elem *b_,
+             void *aux UNUSED)
+{
+  const struct frame *a = hash_entry (a_, struct frame, hash_elem);
+  const struct frame *b = hash_entry (b_, struct frame, hash_elem);
+  if (a->inode != b->inode)
+    return (uintptr_t) a->inode < (uintptr_t) b->inode;
+  return a->ofs < b->ofs;
+}
+
+/* Returns true if F is an anonymous frame shared copy-on-write
+   by more than one page, which must then all be mapped
+   read-only. */
+bool
+frame_is_cow (struct frame *f)
+{
+  return f->inode == NULL && list_size (&f->pages) > 1;
+}
+
+/* Keeps F from being evicted until a matching frame_unpin().
+   Pins are counted, because a shared frame may be pinned through
+   several of the pages mapping it at once.  The frame table lock
+   must be held. */
+void
+frame_pin (struct frame *f)
+{
+  ASSERT (lock_held_by_current_thread (&frame_lock));
+  f->pin_cnt++;
+}
+
+/* Drops a pin taken on F by frame_pin().  If that was the last
+   pin and no page maps F any more, frees it as frame_release()
+   would, returning true.  The frame table lock must be held. */
+bool
+frame_unpin (struct frame *f)
+{
+  ASSERT (lock_held_by_current_thread (&frame_lock));
+  ASSERT (f->pin_cnt > 0);
+
+  if (--f->pin_cnt == 0 && list_empty (&f->pages))
+    return frame_retire (f);
+  return false;
+}
+
+/* Maps every page held in F back into its owner's page
+   directory. */
+static void
+frame_remap (struct frame *f)
+{
+  bool cow = frame_is_cow (f);
+  struct list_elem *e;
+
+  for (e = list_begin (&f->pages); e != list_end (&f->pages);
+       e = list_next (e))
+    {
+      struct page *p = list_entry (e, struct page, frame_elem);
+      if (!pagedir_set_page (p->owner->pagedir, p->upage, f->kpage,
+                             p->writable && !cow))
+        PANIC ("cannot remap page that could not be swapped out");
+    }
+}
+
+/* Returns the first page mapping anonymous frame F. */
+static struct page *
+frame_page (struct frame *f)
+{
+  return list_entry (list_front (&f->pages), struct page, frame_elem);
+}
+
+/* Returns true if any page mapping F has been accessed since the
+   last call, clearing the accessed bits. */
+static bool
+frame_accessed (struct frame *f)
+{
+  struct list_elem *e;
+  bool accessed = false;
+
+  for (e = list_begin (&f->pages); e != list_end (&f->pages);
+       e = list_next (e))
+    {
+      struct page *p = list_entry (e, struct page, frame_elem);
+      uint32_t *pd = p->owner->pagedir;
+      if (pagedir_is_accessed (pd, p->upage))
+        {
+          pagedir_set_accessed (pd, p->upage, false);
+          accessed = true;
+        }
+    }
+  return accessed;
+}
+
+/* Unmaps every page mapping F and returns true if any of them
+   modified it. */
+static bool
+frame_unmap (struct frame *f)
+{
+  struct list_elem *e;
+  bool dirty = f->dirty;
+
+  for (e = list_begin (&f->pages); e != list_end (&f->pages);
+       e = list_next (e))
+    {
+      struct page *p = list_entry (e, struct page, frame_elem);
+      uint32_t *pd = p->owner->pagedir;
+      pagedir_clear_page (pd, p->upage);
+      if (pagedir_is_dirty (pd, p->upage))
+        dirty = true;
+    }
+  return dirty;
+}
+
+/* Advances the clock hand and returns the frame it was on. */
+static struct frame *
+clock_next (void)
+{
+  struct frame *f;
+
+  if (clock_hand == NULL || clock_hand == list_end (&frame_table))
+    clock_hand = list_begin (&frame_table);
+  f = list_entry (clock_hand, struct frame, elem);
+  clock_hand = list_next (clock_hand);
+  return f;
+}
+
+/* Sweeps the clock hand to choose up to SWAP_CLUSTER_PAGES
+   victims, storing them in VICTIMS[] and returning how many
+   were found.  Frames accessed since the hand last passed get a
+   second chance.  The hand makes at most two full turns looking
+   for the first victim, and once one is found, at most one more
+   turn gathering the rest of the cluster. */
+static size_t
+select_victims (struct frame *victims[])
+{
+  size_t frame_cnt = list_size (&frame_table);
+  size_t budget = 2 * frame_cnt;
+  size_t cnt = 0;
+
+  while (cnt < SWAP_CLUSTER_PAGES && budget-- > 0)
+    {
+      struct frame *f = clock_next ();
+
+      if (f->pin_cnt > 0 || frame_accessed (f))
+        continue;
+      if (cnt++ == 0 && budget > frame_cnt - 1)
+        budget = frame_cnt - 1;
+      victims[cnt - 1] = f;
+    }
+  return cnt;
+}
+
+/* Returns true if victim A should precede victim B in a swap
+   run: pages of the same process are kept together, in address
+   order, so that a later fault can read them back in one go. */
+static bool
+victim_less (struct frame *a_, struct frame *b_)
+{
+  const struct page *a = frame_page (a_);
+  const struct page *b = frame_page (b_);
+  if (a->owner != b->owner)
+    return (uintptr_t) a->owner < (uintptr_t) b->owner;
+  return (uintptr_t) a->upage < (uintptr_t) b->upage;
+}
+
+/* Evicts a cluster of pages chosen by the clock algorithm.
+   Clean pages are simply dropped, since they can be re-read
+   from their file, zero-filled, or read back from the swap slot
+   they still have.  Modified shared file frames are written back
+   to their file, which releases the frame table lock meanwhile.
+   Other dirty pages are written to a run of consecutive swap
+   slots in a single request.  Returns true if at least one frame
+   was returned to the user pool. */
+static bool
+evict_cluster (void)
+{
+  struct frame *victims[SWAP_CLUSTER_PAGES];
+  struct frame *dirty[SWAP_CLUSTER_PAGES];
+  struct frame *files[SWAP_CLUSTER_PAGES];
+  void *kpages[SWAP_CLUSTER_PAGES];
+  size_t victim_cnt, dirty_cnt = 0, file_cnt = 0, freed_cnt = 0;
+  size_t slot = SWAP_ERROR;
+  size_t i, j;
+
+  victim_cnt = select_victims (victims);
+
+  /* Unmap every victim first, so that its owners fault (and
+     wait for us) instead of modifying it while it is written
+     out.  Only then are the dirty bits final. */
+  for (i = 0; i < victim_cnt; i++)
+    {
+      struct frame *f = victims[i];
+
+      if (!frame_unmap (f))
+        {
+          frame_free (f);
+          freed_cnt++;
+        }
+      else if (f->inode != NULL)
+        {
+          /* Written back last, without the frame table lock.
+             The pin keeps F alive until then even if its pages
+             fault it back in. */
+          frame_detach (f);
+          f->dirty = true;
+          frame_pin (f);
+          files[file_cnt++] = f;
+        }
+      else
+        {
+          /* Insertion sort into DIRTY[]. */
+          for (j = dirty_cnt++; j > 0 && victim_less (f, dirty[j - 1]); j--)
+            dirty[j] = dirty[j - 1];
+          dirty[j] = f;
+        }
+    }
+
+  /* Find a run of slots for the dirty victims, shrinking the
+     cluster if swap is too fragmented.  Victims that do not fit
+     are mapped back in. */
+  while (dirty_cnt > 0 && (slot = swap_alloc (dirty_cnt)) == SWAP_ERROR)
+    {
+      struct frame *f = dirty[--dirty_cnt];
+      frame_remap (f);
+      f->dirty = true;
+    }
+  if (dirty_cnt > 0)
+    {
+      for (i = 0; i < dirty_cnt; i++)
+        kpages[i] = dirty[i]->kpage;
+      swap_write (slot, dirty_cnt, kpages);
+      freed_cnt += dirty_cnt;
+    }
+
+  /* Every page sharing a frame now shares its slot. */
+  for (i = 0; i < dirty_cnt; i++)
+    {
+      struct list_elem *e;
+
+      for (e = list_begin (&dirty[i]->pages);
+           e != list_end (&dirty[i]->pages); e = list_next (e))
+        {
+          struct page *p = list_entry (e, struct page, frame_elem);
+          if (p->swap_slot != SWAP_ERROR)
+            swap_free (p->swap_slot, 1);
+          if (e != list_begin (&dirty[i]->pages))
+            swap_share (slot + i);
+          p->type = PAGE_SWAP;
+          p->swap_slot = slot + i;
+        }
+      frame_free (dirty[i]);
+    }
+
+  for (i = 0; i < file_cnt; i++)
+    if (frame_unpin (files[i]))
+      freed_cnt++;
+  return freed_cnt > 0;
+}
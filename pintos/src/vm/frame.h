@@ -0,0 +1,52 @@
+#ifndef VM_FRAME_H
+#define VM_FRAME_H
+
+#include <hash.h>
+#include <list.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "filesys/off_t.h"
+
+struct inode;
+struct page;
+
+/* A physical frame from the user pool holding a user page.
+
+   An anonymous frame is mapped by one page, or copy-on-write by
+   the corresponding pages of processes related by fork().  A
+   shared file frame holds WRITE_BYTES bytes of INODE at offset
+   OFS and is mapped by every memory-mapped page of that file
+   region, in any process. */
+struct frame
+  {
+    void *kpage;                /* Kernel virtual address of the frame. */
+    struct list pages;          /* Pages mapping the frame. */
+    int pin_cnt;                /* Pins held, never evicted while > 0. */
+    bool dirty;                 /* Modified through a since-removed mapping. */
+    struct list_elem elem;      /* Element in the frame table. */
+
+    /* Shared file frames only. */
+    struct inode *inode;        /* File region held, or NULL if anonymous. */
+    off_t ofs;                  /* Offset in INODE. */
+    size_t write_bytes;         /* Bytes to write back to INODE. */
+    struct hash_elem hash_elem; /* Element in the shared frame table. */
+  };
+
+void frame_init (void);
+void frame_lock_acquire (void);
+void frame_lock_release (void);
+
+struct frame *frame_alloc (struct page *);
+struct frame *frame_try_alloc (struct page *);
+void *frame_alloc_kpages (size_t page_cnt);
+void frame_attach (struct frame *, struct page *);
+void frame_release (struct page *);
+bool frame_is_cow (struct frame *);
+void frame_pin (struct frame *);
+bool frame_unpin (struct frame *);
+
+struct frame *frame_lookup_shared (struct inode *, off_t ofs);
+void frame_share (struct frame *, struct inode *, off_t ofs,
+                  size_t write_bytes);
+
+#endif /* vm/frame.h */
@@ -0,0 +1,147 @@
+#include "vm/mmap.h"
+#include <debug.h>
+#include <stdint.h>
+#include "filesys/file.h"
+#include "threads/malloc.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
+#include "vm/page.h"
+
+/* Removes the pages of mapping M from the current process,
+   writing modified ones back, and frees M. */
+static void
+unmap (struct mapping *m)
+{
+  size_t i;
+
+  for (i = 0; i < m->page_cnt; i++)
+    page_remove ((uint8_t *) m->base + i * PGSIZE);
+  list_remove (&m->elem);
+  file_close (m->file);
+  free (m);
+}
+
+/* Maps FILE into the current process starting at ADDR.  Pages
+   are read in lazily on first access, and only the ones that
+   were modified are written back, when evicted or unmapped.
+   Processes mapping the same file region share its frames.
+   Returns the new mapping's identifier, or MAP_FAILED if ADDR is
+   null or not page-aligned, FILE is empty, the mapping would
+   overlap existing pages, or memory allocation fails. */
+mapid_t
+mmap_map (struct file *file, void *addr)
+{
+  struct thread *t = thread_current ();
+  struct mapping *m;
+  off_t length;
+  size_t i;
+
+  if (addr == NULL || pg_ofs (addr) != 0 || !is_user_vaddr (addr))
+    return MAP_FAILED;
+  length = file_length (file);
+  if (length <= 0
+      || (uintptr_t) length > (uintptr_t) PHYS_BASE - (uintptr_t) addr)
+    return MAP_FAILED;
+
+  m = malloc (sizeof *m);
+  if (m == NULL)
+    return MAP_FAILED;
+  m->file = file_reopen (file);
+  if (m->file == NULL)
+    {
+      free (m);
+      return MAP_FAILED;
+    }
+  m->id = t->next_mapid++;
+  m->base = addr;
+  m->page_cnt = 0;
+  list_push_back (&t->mappings, &m->elem);
+
+  for (i = 0; (off_t) (i * PGSIZE) < length; i++)
+    {
+      off_t ofs = i * PGSIZE;
+      size_t read_bytes = length - ofs < PGSIZE ? length - ofs : PGSIZE;
+
+      if (!page_add_mmap ((uint8_t *) addr + ofs, m->file, ofs, read_bytes))
+        {
+          unmap (m);
+          return MAP_FAILED;
+        }
+      m->page_cnt++;
+    }
+  return m->id;
+}
+
+/* Unmaps mapping MAPPING of the current process, if it exists. */
+void
+mmap_unmap (mapid_t mapping)
+{
+  struct thread *t = thread_current ();
+  struct list_elem *e;
+
+  for (e = list_begin (&t->mappings); e != list_end (&t->mappings);
+       e = list_next (e))
+    {
+      struct mapping *m = list_entry (e, struct mapping, elem);
+      if (m->id == mapping)
+        {
+          unmap (m);
+          return;
+        }
+    }
+}
+
+/* Unmaps every mapping of the current process. */
+void
+mmap_unmap_all (void)
+{
+  struct thread *t = thread_current ();
+
+  while (!list_empty (&t->mappings))
+    unmap (list_entry (list_front (&t->mappings), struct mapping, elem));
+}
+
+/* Gives the current process, a child being created by fork(),
+   the mappings of PARENT, which must be blocked.  The child maps
+   the same file regions, so it shares their frames with PARENT.
+   Returns false if memory allocation fails. */
+bool
+mmap_fork (struct thread *parent)
+{
+  struct thread *t = thread_current ();
+  struct list_elem *e;
+
+  t->next_mapid = parent->next_mapid;
+  for (e = list_begin (&parent->mappings); e != list_end (&parent->mappings);
+       e = list_next (e))
+    {
+      struct mapping *pm = list_entry (e, struct mapping, elem);
+      struct mapping *m;
+      size_t i;
+
+      m = malloc (sizeof *m);
+      if (m == NULL)
+        return false;
+      m->file = file_reopen (pm->file);
+      if (m->file == NULL)
+        {
+          free (m);
+          return false;
+        }
+      m->id = pm->id;
+      m->base = pm->base;
+      m->page_cnt = 0;
+      list_push_back (&t->mappings, &m->elem);
+
+      for (i = 0; i < pm->page_cnt; i++)
+        {
+          void *upage = (uint8_t *) m->base + i * PGSIZE;
+          struct page *p = page_lookup (parent, upage);
+
+          if (!page_add_mmap (upage, m->file, p->file_ofs, p->read_bytes))
+            return false;
+          m->page_cnt++;
+        }
+    }
+  return true;
+}
@@ -0,0 +1,30 @@
+#ifndef VM_MMAP_H
+#define VM_MMAP_H
+
+#include <list.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+struct file;
+struct thread;
+
+/* Memory-mapping identifier. */
+typedef int mapid_t;
+#define MAP_FAILED ((mapid_t) -1)
+
+/* A file mapped into a process's address space. */
+struct mapping
+  {
+    mapid_t id;                 /* Mapping identifier. */
+    struct file *file;          /* Private handle on the mapped file. */
+    void *base;                 /* First mapped page. */
+    size_t page_cnt;            /* Number of mapped pages. */
+    struct list_elem elem;      /* Element in thread's `mappings' list. */
+  };
+
+mapid_t mmap_map (struct file *, void *addr);
+void mmap_unmap (mapid_t);
+void mmap_unmap_all (void);
+bool mmap_fork (struct thread *parent);
+
+#endif /* vm/mmap.h */
@@ -0,0 +1,596 @@
+#include "vm/page.h"
+#include <debug.h>
+#include <string.h>
+#include "filesys/file.h"
+#include "threads/malloc.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
+#include "userprog/pagedir.h"
+#include "vm/frame.h"
+#include "vm/swap.h"
+
+/* Maximum size of a process's stack, in pages.  Set by the
+   kernel command-line option "-sl". */
+size_t stack_page_limit = STACK_PAGE_LIMIT;
+
+static bool page_load (struct page *);
+
+/* Returns a hash value for page P. */
+static unsigned
+page_hash (const struct hash_elem *p_, void *aux UNUSED)
+{
+  const struct page *p = hash_entry (p_, struct page, hash_elem);
+  return hash_bytes (&p->upage, sizeof p->upage);
+}
+
+/* Returns true if page A precedes page B. */
+static bool
+page_less (const struct hash_elem *a_, const struct hash_elem *b_,
+           void *aux UNUSED)
+{
+  const struct page *a = hash_entry (a_, struct page, hash_elem);
+  const struct page *b = hash_entry (b_, struct page, hash_elem);
+  return a->upage < b->upage;
+}
+
+/* Initializes supplemental page table PAGES.
+   Returns false if memory allocation fails. */
+bool
+page_table_init (struct hash *pages)
+{
+  return hash_init (pages, page_hash, page_less, NULL);
+}
+
+/* Releases the frame and swap slot held by page P_ and frees
+   it. */
+static void
+page_destroy (struct hash_elem *p_, void *aux UNUSED)
+{
+  struct page *p = hash_entry (p_, struct page, hash_elem);
+
+  if (p->type == PAGE_SHM)
+    pagedir_clear_page (p->owner->pagedir, p->upage);
+  if (p->frame != NULL)
+    frame_release (p);
+  if (p->swap_slot != SWAP_ERROR)
+    swap_free (p->swap_slot, 1);
+  free (p);
+}
+
+/* Destroys supplemental page table PAGES, releasing every frame
+   and swap slot it refers to.  Must be called before the owning
+   page directory is destroyed. */
+void
+page_table_destroy (struct hash *pages)
+{
+  frame_lock_acquire ();
+  hash_destroy (pages, page_destroy);
+  frame_lock_release ();
+}
+
+/* Returns the page of thread T containing user virtual address
+   UADDR, or a null pointer if there is no such page. */
+struct page *
+page_lookup (struct thread *t, const void *uaddr)
+{
+  struct page p;
+  struct hash_elem *e;
+
+  p.upage = pg_round_down (uaddr);
+  e = hash_find (&t->pages, &p.hash_elem);
+  return e != NULL ? hash_entry (e, struct page, hash_elem) : NULL;
+}
+
+/* Adds a non-resident page at UPAGE to the current process's
+   supplemental page table, with contents of the given TYPE.
+   Returns the new page, or a null pointer if UPAGE is already
+   in use or memory allocation fails. */
+static struct page *
+page_add (void *upage, enum page_type type, bool writable)
+{
+  struct thread *t = thread_current ();
+  struct page *p;
+
+  ASSERT (pg_ofs (upage) == 0);
+  ASSERT (is_user_vaddr (upage));
+
+  p = malloc (sizeof *p);
+  if (p == NULL)
+    return NULL;
+  p->upage = upage;
+  p->owner = t;
+  p->writable = writable;
+  p->type = type;
+  p->frame = NULL;
+  p->file = NULL;
+  p->file_ofs = 0;
+  p->read_bytes = 0;
+  p->kpage = NULL;
+  p->swap_slot = SWAP_ERROR;
+  if (hash_insert (&t->pages, &p->hash_elem) != NULL)
+    {
+      free (p);
+      return NULL;
+    }
+  return p;
+}
+
+/* Adds a zero-filled page at UPAGE to the current process.
+   Returns false if UPAGE is already in use or memory allocation
+   fails. */
+bool
+page_add_zero (void *upage, bool writable)
+{
+  return page_add (upage, PAGE_ZERO, writable) != NULL;
+}
+
+/* Adds a page at UPAGE to the current process whose first
+   READ_BYTES bytes come from FILE at offset OFS, the rest being
+   zeros.  FILE must stay open as long as the page exists.
+   Returns false if UPAGE is already in use or memory allocation
+   fails. */
+bool
+page_add_file (void *upage, struct file *file, off_t ofs,
+               size_t read_bytes, bool writable)
+{
+  struct page *p;
+
+  ASSERT (read_bytes <= PGSIZE);
+
+  p = page_add (upage, PAGE_FILE, writable);
+  if (p == NULL)
+    return false;
+  p->file = file;
+  p->file_ofs = ofs;
+  p->read_bytes = read_bytes;
+  return true;
+}
+
+/* Adds a page at UPAGE to the current process that maps
+   READ_BYTES bytes of FILE at offset OFS, the rest being zeros.
+   Modifications are written back to the file when the page is
+   evicted or removed.  The frame is shared with every other
+   mapping of the same file region.  Returns false if UPAGE is
+   already in use or memory allocation fails. */
+bool
+page_add_mmap (void *upage, struct file *file, off_t ofs,
+               size_t read_bytes)
+{
+  struct page *p;
+
+  ASSERT (read_bytes <= PGSIZE);
+
+  p = page_add (upage, PAGE_MMAP, true);
+  if (p == NULL)
+    return false;
+  p->file = file;
+  p->file_ofs = ofs;
+  p->read_bytes = read_bytes;
+  return true;
+}
+
+/* Adds a page at UPAGE to the current process that maps KPAGE, a
+   frame of a shared-memory segment, and maps it at once.  The
+   page is writable and never evicted.  Returns false if UPAGE is
+   already in use or memory allocation fails. */
+bool
+page_add_shm (void *upage, void *kpage)
+{
+  struct page *p;
+
+  p = page_add (upage, PAGE_SHM, true);
+  if (p == NULL)
+    return false;
+  p->kpage = kpage;
+  if (!pagedir_set_page (p->owner->pagedir, upage, kpage, true))
+    {
+      hash_delete (&p->owner->pages, &p->hash_elem);
+      free (p);
+      return false;
+    }
+  return true;
+}
+
+/* Removes the page at UPAGE from the current process, writing it
+   back to its file first if it is a modified memory-mapped
+   page. */
+void
+page_remove (void *upage)
+{
+  struct thread *t = thread_current ();
+  struct page *p = page_lookup (t, upage);
+
+  if (p == NULL)
+    return;
+  frame_lock_acquire ();
+  hash_delete (&t->pages, &p->hash_elem);
+  page_destroy (&p->hash_elem, NULL);
+  frame_lock_release ();
+}
+
+/* Copies the supplemental page table of PARENT, which must be
+   blocked, into the current process, whose page directory must
+   be empty and whose executable must already be open.  Nothing
+   is copied: resident anonymous pages are mapped read-only in
+   both processes and shared until one of them writes (see
+   page_unshare()), and swap slots are shared by reference.
+   Memory-mapped and shared-memory pages are left to mmap_fork()
+   and shm_fork().  Returns false if memory allocation fails. */
+bool
+page_table_fork (struct thread *parent)
+{
+  struct thread *t = thread_current ();
+  struct hash_iterator i;
+  bool success = true;
+
+  frame_lock_acquire ();
+  hash_first (&i, &parent->pages);
+  while (success && hash_next (&i))
+    {
+      struct page *p = hash_entry (hash_cur (&i), struct page, hash_elem);
+      struct page *q;
+
+      if (p->type == PAGE_MMAP || p->type == PAGE_SHM)
+        continue;
+      q = page_add (p->upage, p->type, p->writable);
+      if (q == NULL)
+        {
+          success = false;
+          break;
+        }
+      if (p->file != NULL)
+        q->file = t->exec_file;
+      q->file_ofs = p->file_ofs;
+      q->read_bytes = p->read_bytes;
+      if (p->swap_slot != SWAP_ERROR)
+        {
+          swap_share (p->swap_slot);
+          q->swap_slot = p->swap_slot;
+        }
+      if (p->frame != NULL)
+        {
+          frame_attach (p->frame, q);
+          pagedir_set_writable (parent->pagedir, p->upage, false);
+          success = pagedir_set_page (t->pagedir, q->upage,
+                                      p->frame->kpage, false);
+        }
+    }
+  frame_lock_release ();
+  return success;
+}
+
+/* Maps page P, now resident in its frame, into its owner's page
+   directory.  If memory allocation fails, releases the frame and
+   returns false. */
+static bool
+page_map (struct page *p)
+{
+  if (!pagedir_set_page (p->owner->pagedir, p->upage, p->frame->kpage,
+                         p->writable && !frame_is_cow (p->frame)))
+    {
+      frame_release (p);
+      return false;
+    }
+  return true;
+}
+
+/* Brings swapped-out page P back in.  Neighbouring pages of the
+   same process that were swapped out into the adjacent slots
+   (eviction writes a process's pages to consecutive slots in
+   address order) are read in the same disk request, as long as
+   free frames are available for them without evicting.  This
+   lets a sequential scan over swapped memory proceed at disk
+   bandwidth. */
+static bool
+page_load_swap (struct page *p)
+{
+  struct page *run[SWAP_CLUSTER_PAGES];
+  void *kpages[SWAP_CLUSTER_PAGES];
+  struct frame *f;
+  size_t before = 0, cnt, i;
+  bool success = true;
+
+  f = frame_alloc (p);
+  if (f == NULL)
+    return false;
+
+  /* Find neighbours below P, then above it. */
+  while (before + 1 < SWAP_CLUSTER_PAGES && before < p->swap_slot)
+    {
+      struct page *q = page_lookup (p->owner, (uint8_t *) p->upage
+                                              - (before + 1) * PGSIZE);
+      if (q == NULL || q->frame != NULL || q->type != PAGE_SWAP
+          || q->swap_slot != p->swap_slot - (before + 1))
+        break;
+      before++;
+    }
+  for (i = 0; i < before; i++)
+    run[i] = page_lookup (p->owner, (uint8_t *) p->upage
+                                    - (before - i) * PGSIZE);
+  run[before] = p;
+  for (cnt = before + 1; cnt < SWAP_CLUSTER_PAGES; cnt++)
+    {
+      struct page *q = page_lookup (p->owner, (uint8_t *) p->upage
+                                              + (cnt - before) * PGSIZE);
+      if (q == NULL || q->frame != NULL || q->type != PAGE_SWAP
+          || q->swap_slot != p->swap_slot + (cnt - before))
+        break;
+      run[cnt] = q;
+    }
+
+  /* Get frames for the neighbours.  Trim the run at the first
+     neighbour on either side that cannot get one. */
+  kpages[before] = f->kpage;
+  for (i = before + 1; i < cnt; i++)
+    {
+      struct frame *g = frame_try_alloc (run[i]);
+      if (g == NULL)
+        break;
+      kpages[i] = g->kpage;
+    }
+  cnt = i;
+  for (i = before; i-- > 0; )
+    {
+      struct frame *g = frame_try_alloc (run[i]);
+      if (g == NULL)
+        break;
+      kpages[i] = g->kpage;
+    }
+  i++;
+
+  swap_read (run[i]->swap_slot, cnt - i, kpages + i);
+
+  /* Map the pages.  Each keeps its swap slot as long as it stays
+     clean, so evicting it again is free. */
+  for (; i < cnt; i++)
+    if (!page_map (run[i]) && run[i] == p)
+      success = false;
+  return success;
+}
+
+/* Loads page P into a newly allocated frame and maps it.
+   The frame table lock must be held. */
+static bool
+page_load (struct page *p)
+{
+  struct frame *f;
+
+  ASSERT (p->frame == NULL);
+
+  if (p->type == PAGE_SWAP)
+    return page_load_swap (p);
+  if (p->type == PAGE_SHM)
+    return pagedir_set_page (p->owner->pagedir, p->upage, p->kpage,
+                             p->writable);
+
+  if (p->type == PAGE_MMAP)
+    {
+      /* Share the frame of any other mapping of the same file
+         region. */
+      f = frame_lookup_shared (file_get_inode (p->file), p->file_ofs);
+      if (f != NULL)
+        {
+          frame_attach (f, p);
+          return page_map (p);
+        }
+    }
+
+  f = frame_alloc (p);
+  if (f == NULL)
+    return false;
+  if (p->type == PAGE_MMAP)
+    {
+      /* Eviction may have let another mapping load the region
+         while the frame table lock was released. */
+      struct frame *g = frame_lookup_shared (file_get_inode (p->file),
+                                             p->file_ofs);
+      if (g != NULL)
+        {
+          frame_release (p);
+          frame_attach (g, p);
+          return page_map (p);
+        }
+    }
+
+  if (p->type == PAGE_FILE || p->type == PAGE_MMAP)
+    {
+      if (file_read_at (p->file, f->kpage, p->read_bytes, p->file_ofs)
+          != (off_t) p->read_bytes)
+        {
+          frame_release (p);
+          return false;
+        }
+      memset ((uint8_t *) f->kpage + p->read_bytes, 0,
+              PGSIZE - p->read_bytes);
+      if (p->type == PAGE_MMAP)
+        frame_share (f, file_get_inode (p->file), p->file_ofs,
+                     p->read_bytes);
+    }
+  else
+    memset (f->kpage, 0, PGSIZE);
+
+  return page_map (p);
+}
+
+/* Returns true if an access to user address UADDR, with the
+   user stack pointer at ESP, should be taken as growing the
+   stack.  The access must lie within the stack size limit and
+   no more than 32 bytes below ESP, the most that any instruction
+   (PUSHA) writes below the stack pointer before updating it. */
+bool
+page_is_stack (const void *uaddr, const void *esp)
+{
+  return (is_user_vaddr (uaddr)
+          && (uintptr_t) uaddr + 32 >= (uintptr_t) esp
+          && (uintptr_t) PHYS_BASE - (uintptr_t) uaddr
+             <= stack_page_limit * PGSIZE);
+}
+
+/* Returns the page of the current process containing UADDR.  If
+   there is none but UADDR is a stack access relative to user
+   stack pointer ESP, adds a zero-filled stack page for it.
+   Returns a null pointer if UADDR is not part of the process's
+   address space. */
+static struct page *
+page_lookup_stack (const void *uaddr, const void *esp)
+{
+  struct page *p = page_lookup (thread_current (), uaddr);
+
+  if (p == NULL && page_is_stack (uaddr, esp))
+    p = page_add (pg_round_down (uaddr), PAGE_ZERO, true);
+  return p;
+}
+
+/* Brings in the page containing FAULT_ADDR in the current
+   process, growing the stack if FAULT_ADDR looks like a stack
+   access relative to user stack pointer ESP.  Returns true if
+   successful, false if FAULT_ADDR is not part of the process's
+   address space or if the page could not be loaded. */
+bool
+page_fault_in (const void *fault_addr, const void *esp)
+{
+  struct thread *t = thread_current ();
+  struct page *p;
+  bool success;
+
+  if (t->pagedir == NULL || !is_user_vaddr (fault_addr))
+    return false;
+  p = page_lookup_stack (fault_addr, esp);
+  if (p == NULL)
+    return false;
+
+  frame_lock_acquire ();
+  success = p->frame != NULL || page_load (p);
+  frame_lock_release ();
+  return success;
+}
+
+/* Makes resident page P writable, giving it a private copy of
+   its frame if the frame is shared copy-on-write.  The frame
+   table lock must be held. */
+static bool
+page_copy (struct page *p)
+{
+  struct frame *f = p->frame;
+  struct frame *g;
+
+  if (!frame_is_cow (f))
+    {
+      /* The other sharers are gone. */
+      pagedir_set_writable (p->owner->pagedir, p->upage, true);
+      return true;
+    }
+
+  /* Keep F from being evicted until it has been copied.  The
+     other sharers may have pinned it too, so this adds a pin of
+     our own instead of overriding theirs. */
+  frame_pin (f);
+  frame_release (p);
+  g = frame_alloc (p);
+  if (g == NULL)
+    {
+      frame_attach (f, p);
+      frame_unpin (f);
+      page_map (p);
+      return false;
+    }
+
+  /* The copy is about to be written, so its swap slot would be
+     stale anyway. */
+  memcpy (g->kpage, f->kpage, PGSIZE);
+  frame_unpin (f);
+  g->dirty = true;
+  if (p->swap_slot != SWAP_ERROR)
+    {
+      swap_free (p->swap_slot, 1);
+      p->swap_slot = SWAP_ERROR;
+    }
+  return page_map (p);
+}
+
+/* Handles a write to the present, read-only page containing
+   FAULT_ADDR in the current process.  Returns true if the page
+   is writable but was shared copy-on-write, in which case the
+   process now has its own copy, false if the page is really
+   read-only or no frame could be found for the copy. */
+bool
+page_unshare (const void *fault_addr)
+{
+  struct thread *t = thread_current ();
+  struct page *p;
+  bool success;
+
+  if (t->pagedir == NULL || !is_user_vaddr (fault_addr))
+    return false;
+  p = page_lookup (t, fault_addr);
+  if (p == NULL || !p->writable)
+    return false;
+
+  frame_lock_acquire ();
+  success = p->frame != NULL ? page_copy (p) : page_load (p);
+  frame_lock_release ();
+  return success;
+}
+
+/* Makes every page in the SIZE bytes at UADDR resident and pins
+   it, so that the kernel can access the range while holding
+   locks that the page fault handler might need (e.g. a disk
+   channel lock during a direct transfer).  Stack pages below
+   the current ones are added as for a page fault, relative to
+   the user stack pointer saved on entry to the system call.  If
+   WRITE is true the kernel is going to write to the range, so
+   pages shared copy-on-write are copied first.  Returns false if
+   any page is not part of the current process's address space,
+   or is read-only and WRITE is true, in which case nothing is
+   left pinned. */
+bool
+page_pin (const void *uaddr, size_t size, bool write)
+{
+  struct thread *t = thread_current ();
+  const uint8_t *start = pg_round_down (uaddr);
+  const uint8_t *end = (const uint8_t *) uaddr + size;
+  const uint8_t *upage;
+
+  if (size == 0)
+    return true;
+  frame_lock_acquire ();
+  for (upage = start; upage < end; upage += PGSIZE)
+    {
+      struct page *p = page_lookup_stack (upage == start ? uaddr : upage,
+                                          t->user_esp);
+      if (p == NULL || (write && !p->writable)
+          || (p->type != PAGE_SHM
+              && ((p->frame == NULL && !page_load (p))
+                  || (write && !page_copy (p)))))
+        {
+          frame_lock_release ();
+          page_unpin (start, upage - start);
+          return false;
+        }
+
+      /* Shared-memory pages are never evicted anyway. */
+      if (p->frame != NULL)
+        frame_pin (p->frame);
+    }
+  frame_lock_release ();
+  return true;
+}
+
+/* Unpins the pages in the SIZE bytes at UADDR, pinned by a
+   previous call to page_pin(). */
+void
+page_unpin (const void *uaddr, size_t size)
+{
+  struct thread *t = thread_current ();
+  const uint8_t *upage = pg_round_down (uaddr);
+  const uint8_t *end = (const uint8_t *) uaddr + size;
+
+  frame_lock_acquire ();
+  for (; upage < end; upage += PGSIZE)
+    {
+      struct page *p = page_lookup (t, upage);
+      if (p != NULL && p->frame != NULL)
+        frame_unpin (p->frame);
+    }
+  frame_lock_release ();
+}
@@ -0,0 +1,74 @@
+#ifndef VM_PAGE_H
+#define VM_PAGE_H
+
+#include <hash.h>
+#include <list.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "filesys/off_t.h"
+
+struct frame;
+struct thread;
+
+/* Default maximum size of a process's stack, in pages (8 MB). */
+#define STACK_PAGE_LIMIT 2048
+extern size_t stack_page_limit;
+
+/* Where a page's contents come from when it is not resident. */
+enum page_type
+  {
+    PAGE_ZERO,                  /* All zeros. */
+    PAGE_FILE,                  /* READ_BYTES from FILE, rest zeros. */
+    PAGE_SWAP,                  /* Swap slot SWAP_SLOT. */
+    PAGE_MMAP,                  /* Memory-mapped READ_BYTES of FILE. */
+    PAGE_SHM                    /* Shared-memory segment frame KPAGE. */
+  };
+
+/* A page of user virtual memory.
+   Each process keeps one of these per mapped page in its
+   supplemental page table, `pages' in struct thread. */
+struct page
+  {
+    void *upage;                /* User virtual address. */
+    struct thread *owner;       /* Owning process. */
+    bool writable;              /* Read/write if true, read-only if false. */
+    enum page_type type;        /* Backing store. */
+    struct frame *frame;        /* Frame holding the page, or NULL. */
+
+    /* PAGE_FILE and PAGE_MMAP pages. */
+    struct file *file;          /* File to read from. */
+    off_t file_ofs;             /* Offset in FILE. */
+    size_t read_bytes;          /* Bytes to read, rest is zeroed. */
+
+    /* PAGE_SHM pages, always resident outside the frame table. */
+    void *kpage;                /* Segment's frame. */
+
+    /* Slot holding an up-to-date copy of the page, or SWAP_ERROR.
+       Kept while the page is resident and clean, so that
+       evicting it again costs no write. */
+    size_t swap_slot;
+
+    struct list_elem frame_elem; /* Element in frame's `pages' list. */
+    struct hash_elem hash_elem; /* Element in supplemental page table. */
+  };
+
+bool page_table_init (struct hash *);
+void page_table_destroy (struct hash *);
+
+struct page *page_lookup (struct thread *, const void *uaddr);
+bool page_add_zero (void *upage, bool writable);
+bool page_add_file (void *upage, struct file *, off_t ofs,
+                    size_t read_bytes, bool writable);
+bool page_add_mmap (void *upage, struct file *, off_t ofs,
+                    size_t read_bytes);
+bool page_add_shm (void *upage, void *kpage);
+void page_remove (void *upage);
+bool page_table_fork (struct thread *parent);
+
+bool page_is_stack (const void *uaddr, const void *esp);
+bool page_fault_in (const void *fault_addr, const void *esp);
+bool page_unshare (const void *fault_addr);
+bool page_pin (const void *uaddr, size_t size, bool write);
+void page_unpin (const void *uaddr, size_t size);
+
+#endif /* vm/page.h */
@@ -0,0 +1,323 @@
+#include "vm/shm.h"
+#include <debug.h>
+#include <round.h>
+#include <stdint.h>
+#include "threads/malloc.h"
+#include "threads/palloc.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
+#include "vm/frame.h"
+#include "vm/page.h"
+
+/* Shared-memory segments.
+
+   A segment is a set of frames from the user pool that any
+   process may map into its address space, given the segment's
+   identifier.  Every process attached to a segment maps the very
+   same frames, so a store by one is seen by the others at once.
+   The frames are allocated when the segment is created and are
+   never evicted, since the frame table's per-page eviction and
+   copy-on-write machinery assume anonymous frames are private.
+   A segment is freed once no process holds it any longer.  Its
+   creator holds it from the start, so that it outlives the gap
+   before the first attach, but that hold becomes the creator's
+   own attachment when it attaches the segment itself, so that
+   detaching it is enough to free it. */
+struct shm_segment
+  {
+    shmid_t id;                 /* Identifier. */
+    size_t page_cnt;            /* Number of pages. */
+    void **kpages;              /* Frames, PAGE_CNT of them. */
+    bool huge;                  /* KPAGES contiguous, one allocation? */
+    int ref_cnt;                /* Number of shm_attachments. */
+    struct list_elem elem;      /* Element in `segments'. */
+  };
+
+/* Maximum size of a segment, in pages (4 MB). */
+#define SHM_MAX_PAGES 1024
+
+/* Maximum number of segments a process may hold at once, attached
+   or not.  Segment frames cannot be evicted, so this bounds what a
+   process can tie up. */
+#define SHM_MAX_HOLDS 8
+
+/* All segments, and the next identifier to assign. */
+static struct list segments;
+static shmid_t next_id;
+
+/* Protects `segments', `next_id', and reference counts. */
+static struct lock shm_lock;
+
+/* Initializes shared-memory segments. */
+void
+shm_init (void)
+{
+  list_init (&segments);
+  lock_init (&shm_lock);
+  next_id = 0;
+}
+
+/* Frees SEG's frames and SEG itself. */
+static void
+free_segment (struct shm_segment *seg)
+{
+  size_t i;
+
+  if (seg->huge)
+    palloc_free_multiple (seg->kpages[0], seg->page_cnt);
+  else
+    for (i = 0; i < seg->page_cnt; i++)
+      palloc_free_page (seg->kpages[i]);
+  free (seg->kpages);
+  free (seg);
+}
+
+/* Returns the current process's attachment at BASE, of SEG if
+   SEG is nonnull, or a null pointer if there is none. */
+static struct shm_attachment *
+find_attachment (struct shm_segment *seg, void *base)
+{
+  struct thread *t = thread_current ();
+  struct list_elem *e;
+
+  for (e = list_begin (&t->shm); e != list_end (&t->shm); e = list_next (e))
+    {
+      struct shm_attachment *a = list_entry (e, struct shm_attachment, elem);
+      if (a->base == base && (seg == NULL || a->seg == seg))
+        return a;
+    }
+  return NULL;
+}
+
+/* Adds a hold on SEG, attached at BASE, to the current process.
+   Returns false if the process already holds SHM_MAX_HOLDS
+   segments or memory allocation fails. */
+static bool
+hold (struct shm_segment *seg, void *base)
+{
+  struct shm_attachment *a;
+
+  if (list_size (&thread_current ()->shm) >= SHM_MAX_HOLDS)
+    return false;
+  a = malloc (sizeof *a);
+  if (a == NULL)
+    return false;
+  a->seg = seg;
+  a->base = base;
+  list_push_back (&thread_current ()->shm, &a->elem);
+
+  lock_acquire (&shm_lock);
+  seg->ref_cnt++;
+  lock_release (&shm_lock);
+  return true;
+}
+
+/* Drops a reference to SEG, freeing it if none is left. */
+static void
+unref (struct shm_segment *seg)
+{
+  bool unused;
+
+  lock_acquire (&shm_lock);
+  unused = --seg->ref_cnt == 0;
+  if (unused)
+    list_remove (&seg->elem);
+  lock_release (&shm_lock);
+  if (unused)
+    free_segment (seg);
+}
+
+/* Removes attachment A from the current process, unmapping its
+   pages, and frees its segment if no hold is left. */
+static void
+release (struct shm_attachment *a)
+{
+  struct shm_segment *seg = a->seg;
+  size_t i;
+
+  if (a->base != NULL)
+    for (i = 0; i < seg->page_cnt; i++)
+      page_remove ((uint8_t *) a->base + i * PGSIZE);
+  list_remove (&a->elem);
+  free (a);
+  unref (seg);
+}
+
+/* Creates a segment of SIZE bytes, rounded up to whole pages and
+   filled with zeros, held by the current process until it
+   attaches the segment itself or exits.
+   If FLAGS includes SHM_HUGE, the segment is backed by physically
+   contiguous frames.  Returns the new segment's identifier, or
+   SHM_FAILED if SIZE is 0 or too large, the process holds too
+   many segments, or memory is not available. */
+shmid_t
+shm_create (size_t size, int flags)
+{
+  struct shm_segment *seg;
+  size_t page_cnt = DIV_ROUND_UP (size, PGSIZE);
+  size_t i;
+
+  if (page_cnt == 0 || page_cnt > SHM_MAX_PAGES
+      || list_size (&thread_current ()->shm) >= SHM_MAX_HOLDS)
+    return SHM_FAILED;
+
+  seg = malloc (sizeof *seg);
+  if (seg == NULL)
+    return SHM_FAILED;
+  seg->kpages = calloc (page_cnt, sizeof *seg->kpages);
+  if (seg->kpages == NULL)
+    {
+      free (seg);
+      return SHM_FAILED;
+    }
+  seg->page_cnt = page_cnt;
+  seg->huge = (flags & SHM_HUGE) != 0;
+  seg->ref_cnt = 0;
+
+  /* Take the frames from the user pool, evicting pages to make
+     room if necessary. */
+  frame_lock_acquire ();
+  if (seg->huge)
+    {
+      uint8_t *base = frame_alloc_kpages (page_cnt);
+      for (i = 0; base != NULL && i < page_cnt; i++)
+        seg->kpages[i] = base + i * PGSIZE;
+    }
+  else
+    for (i = 0; i < page_cnt; i++)
+      {
+        seg->kpages[i] = frame_alloc_kpages (1);
+        if (seg->kpages[i] == NULL)
+          break;
+      }
+  frame_lock_release ();
+  if (i < page_cnt)
+    {
+      seg->page_cnt = i;
+      seg->huge = false;
+      free_segment (seg);
+      return SHM_FAILED;
+    }
+
+  /* Hold the segment before anyone else can find it. */
+  if (!hold (seg, NULL))
+    {
+      free_segment (seg);
+      return SHM_FAILED;
+    }
+  lock_acquire (&shm_lock);
+  seg->id = next_id++;
+  list_push_back (&segments, &seg->elem);
+  lock_release (&shm_lock);
+  return seg->id;
+}
+
+/* Maps SEG into the current process at BASE and records the
+   attachment, in place of the creator's hold if the process has
+   one.  Returns false if the pages would overlap existing ones,
+   the process holds too many segments, or memory allocation
+   fails. */
+static bool
+attach (struct shm_segment *seg, void *base)
+{
+  struct shm_attachment *a;
+  size_t i;
+
+  for (i = 0; i < seg->page_cnt; i++)
+    if (!page_add_shm ((uint8_t *) base + i * PGSIZE, seg->kpages[i]))
+      break;
+  if (i == seg->page_cnt)
+    {
+      a = find_attachment (seg, NULL);
+      if (a != NULL)
+        {
+          a->base = base;
+          return true;
+        }
+      if (hold (seg, base))
+        return true;
+    }
+
+  while (i-- > 0)
+    page_remove ((uint8_t *) base + i * PGSIZE);
+  return false;
+}
+
+/* Maps segment ID into the current process starting at ADDR.
+   Returns ADDR, or a null pointer if there is no such segment,
+   ADDR is null or not page-aligned, the segment would overlap
+   existing pages, or memory allocation fails. */
+void *
+shm_attach (shmid_t id, void *addr)
+{
+  struct shm_segment *seg = NULL;
+  struct list_elem *e;
+
+  if (addr == NULL || pg_ofs (addr) != 0 || !is_user_vaddr (addr))
+    return NULL;
+
+  /* Find the segment, and keep it alive while we attach it. */
+  lock_acquire (&shm_lock);
+  for (e = list_begin (&segments); e != list_end (&segments);
+       e = list_next (e))
+    if (list_entry (e, struct shm_segment, elem)->id == id)
+      {
+        seg = list_entry (e, struct shm_segment, elem);
+        seg->ref_cnt++;
+        break;
+      }
+  lock_release (&shm_lock);
+  if (seg == NULL)
+    return NULL;
+
+  if (seg->page_cnt * PGSIZE > (uintptr_t) PHYS_BASE - (uintptr_t) addr
+      || !attach (seg, addr))
+    addr = NULL;
+  unref (seg);
+  return addr;
+}
+
+/* Detaches the segment attached at ADDR from the current process.
+   Returns false if no segment is attached there. */
+bool
+shm_detach (void *addr)
+{
+  struct shm_attachment *a;
+
+  if (addr == NULL || (a = find_attachment (NULL, addr)) == NULL)
+    return false;
+  release (a);
+  return true;
+}
+
+/* Releases every segment attached to or held by the current
+   process. */
+void
+shm_detach_all (void)
+{
+  struct thread *t = thread_current ();
+
+  while (!list_empty (&t->shm))
+    release (list_entry (list_front (&t->shm), struct shm_attachment, elem));
+}
+
+/* Gives the current process, a child being created by fork(),
+   the attachments of PARENT, which must be blocked.  The child
+   maps the same frames, so the segments stay shared rather than
+   becoming copy-on-write.  Returns false if memory allocation
+   fails. */
+bool
+shm_fork (struct thread *parent)
+{
+  struct list_elem *e;
+
+  for (e = list_begin (&parent->shm); e != list_end (&parent->shm);
+       e = list_next (e))
+    {
+      struct shm_attachment *pa = list_entry (e, struct shm_attachment, elem);
+      if (pa->base != NULL && !attach (pa->seg, pa->base))
+        return false;
+    }
+  return true;
+}
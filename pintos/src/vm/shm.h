@@ -0,0 +1,35 @@
+#ifndef VM_SHM_H
+#define VM_SHM_H
+
+#include <list.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+struct thread;
+
+/* Shared-memory segment identifier. */
+typedef int shmid_t;
+#define SHM_FAILED ((shmid_t) -1)
+
+/* shm_create() flags. */
+#define SHM_HUGE 0x1            /* Physically contiguous backing. */
+
+/* A shared-memory segment attached to a process.  The segment's
+   creator also holds it, with a null BASE, until it attaches the
+   segment or exits, so that a segment outlives the gap between
+   creation and the first attach. */
+struct shm_attachment
+  {
+    struct shm_segment *seg;    /* Segment. */
+    void *base;                 /* First attached page, or null. */
+    struct list_elem elem;      /* Element in thread's `shm' list. */
+  };
+
+void shm_init (void);
+shmid_t shm_create (size_t size, int flags);
+void *shm_attach (shmid_t, void *addr);
+bool shm_detach (void *addr);
+void shm_detach_all (void);
+bool shm_fork (struct thread *parent);
+
+#endif /* vm/shm.h */
@@ -0,0 +1,123 @@
+#include "vm/swap.h"
+#include <bitmap.h>
+#include <debug.h>
+#include <stdint.h>
+#include <stdio.h>
+#include "devices/block.h"
+#include "threads/malloc.h"
+#include "threads/synch.h"
+#include "threads/vaddr.h"
+
+/* Swap space is divided into page-sized slots.  Slot N occupies
+   sectors N * SECTORS_PER_SLOT through (N + 1) * SECTORS_PER_SLOT
+   - 1 of the swap device.
+
+   Pages are always moved in runs of consecutive slots, so that
+   evicting a cluster of victims or reading back a process's
+   neighbouring pages costs a single disk request instead of one
+   request per sector.
+
+   A slot may back the same page in several processes after a
+   fork(), so each used slot carries a reference count and is
+   only released when the last reference is dropped. */
+
+/* Number of sectors in one swap slot. */
+#define SECTORS_PER_SLOT (PGSIZE / BLOCK_SECTOR_SIZE)
+
+static struct block *swap_device;    /* Swap partition. */
+static struct bitmap *swap_map;      /* Used slots, one bit per slot. */
+static uint16_t *swap_refs;          /* Reference count of each slot. */
+static struct lock swap_lock;        /* Protects swap_map, swap_refs. */
+
+/* Initializes the swap module.  A missing swap device is not an
+   error: every allocation will then simply fail. */
+void
+swap_init (void)
+{
+  size_t slot_cnt = 0;
+
+  lock_init (&swap_lock);
+  swap_device = block_get_role (BLOCK_SWAP);
+  if (swap_device != NULL)
+    slot_cnt = block_size (swap_device) / SECTORS_PER_SLOT;
+  swap_map = bitmap_create (slot_cnt);
+  swap_refs = calloc (slot_cnt + 1, sizeof *swap_refs);
+  if (swap_map == NULL || swap_refs == NULL)
+    PANIC ("swap bitmap creation failed");
+}
+
+/* Allocates PAGE_CNT consecutive swap slots, each with one
+   reference, and returns the first of them, or SWAP_ERROR if no
+   such run is free. */
+size_t
+swap_alloc (size_t page_cnt)
+{
+  size_t slot, i;
+
+  lock_acquire (&swap_lock);
+  slot = bitmap_scan_and_flip (swap_map, 0, page_cnt, false);
+  if (slot != BITMAP_ERROR)
+    for (i = 0; i < page_cnt; i++)
+      swap_refs[slot + i] = 1;
+  lock_release (&swap_lock);
+
+  return slot != BITMAP_ERROR ? slot : SWAP_ERROR;
+}
+
+/* Adds a reference to used slot SLOT. */
+void
+swap_share (size_t slot)
+{
+  lock_acquire (&swap_lock);
+  ASSERT (bitmap_test (swap_map, slot));
+  ASSERT (swap_refs[slot] < UINT16_MAX);
+  swap_refs[slot]++;
+  lock_release (&swap_lock);
+}
+
+/* Drops a reference to each of the PAGE_CNT slots starting at
+   SLOT, releasing those that are no longer referenced. */
+void
+swap_free (size_t slot, size_t page_cnt)
+{
+  size_t i;
+
+  lock_acquire (&swap_lock);
+  ASSERT (bitmap_all (swap_map, slot, page_cnt));
+  for (i = slot; i < slot + page_cnt; i++)
+    if (--swap_refs[i] == 0)
+      bitmap_reset (swap_map, i);
+  lock_release (&swap_lock);
+}
+
+/* Writes the PAGE_CNT pages KPAGES[] to consecutive slots
+   starting at SLOT, as a single disk request. */
+void
+swap_write (size_t slot, size_t page_cnt, void *const kpages[])
+{
+  const void *sectors[SWAP_CLUSTER_PAGES * SECTORS_PER_SLOT];
+  size_t i;
+
+  ASSERT (page_cnt <= SWAP_CLUSTER_PAGES);
+  for (i = 0; i < page_cnt * SECTORS_PER_SLOT; i++)
+    sectors[i] = (uint8_t *) kpages[i / SECTORS_PER_SLOT]
+                 + i % SECTORS_PER_SLOT * BLOCK_SECTOR_SIZE;
+  block_write_multiple (swap_device, slot * SECTORS_PER_SLOT,
+                        page_cnt * SECTORS_PER_SLOT, sectors);
+}
+
+/* Reads PAGE_CNT consecutive slots starting at SLOT into the
+   pages KPAGES[], as a single disk request. */
+void
+swap_read (size_t slot, size_t page_cnt, void *const kpages[])
+{
+  void *sectors[SWAP_CLUSTER_PAGES * SECTORS_PER_SLOT];
+  size_t i;
+
+  ASSERT (page_cnt <= SWAP_CLUSTER_PAGES);
+  for (i = 0; i < page_cnt * SECTORS_PER_SLOT; i++)
+    sectors[i] = (uint8_t *) kpages[i / SECTORS_PER_SLOT]
+                 + i % SECTORS_PER_SLOT * BLOCK_SECTOR_SIZE;
+  block_read_multiple (swap_device, slot * SECTORS_PER_SLOT,
+                       page_cnt * SECTORS_PER_SLOT, sectors);
+}
@@ -0,0 +1,22 @@
+#ifndef VM_SWAP_H
+#define VM_SWAP_H
+
+#include <stddef.h>
+
+/* Returned by swap_alloc() when no run of free slots is left. */
+#define SWAP_ERROR SIZE_MAX
+
+/* Largest number of pages moved by one swap_read() or
+   swap_write() call.  Eviction batches up to this many victims
+   into one run, and a swap-in reads up to this many neighbouring
+   pages along with the one that faulted. */
+#define SWAP_CLUSTER_PAGES 8
+
+void swap_init (void);
+size_t swap_alloc (size_t page_cnt);
+void swap_share (size_t slot);
+void swap_free (size_t slot, size_t page_cnt);
+void swap_write (size_t slot, size_t page_cnt, void *const kpages[]);
+void swap_read (size_t slot, size_t page_cnt, void *const kpages[]);
+
+#endif /* vm/swap.h */